@@ -0,0 +1,254 @@
+/*
+  This is free and unencumbered software released into the public domain.
+
+  Anyone is free to copy, modify, publish, use, compile, sell, or
+  distribute this software, either in source code form or as a compiled
+  binary, for any purpose, commercial or non-commercial, and by any
+  means.
+
+  In jurisdictions that recognize copyright laws, the author or authors
+  of this software dedicate any and all copyright interest in the
+  software to the public domain. We make this dedication for the benefit
+  of the public at large and to the detriment of our heirs and
+  successors. We intend this dedication to be an overt act of
+  relinquishment in perpetuity of all present and future rights to this
+  software under copyright law.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+  OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+  OTHER DEALINGS IN THE SOFTWARE.
+
+  For more information, please refer to <http://unlicense.org/>
+*/
+
+// Band and channel number to frequency tables.
+// Included into an unnamed namespace by zte_mf283plus_watch.cpp.
+// Frequencies are in units of 100 kHz.
+
+// 3GPP TS 36.101 E-UTRA operating bands, indexed by band number.
+// F_DL = DLLow + (EARFCN - DLOffset), F_UL = ULLow + (EARFCN - DLOffset)
+// for the first ULChannels channels. The rest of the downlink range is
+// downlink only (e.g. band 66: 90 MHz down, 70 MHz up).
+
+struct LTEBand {
+  uint8_t Band; // 0: unused entry
+  uint16_t NominalMHz;
+  int32_t DLLow;
+  int32_t DLOffset;
+  int32_t DLLast;
+  int32_t ULLow; // 0: supplemental downlink, DLLow for TDD bands
+  int32_t ULChannels; // 0: supplemental downlink
+};
+
+constexpr LTEBand lteBands[] = {
+  {  0,    0,     0,     0,     0,     0,     0 },
+  {  1, 2100, 21100,     0,   599, 19200,   600 },
+  {  2, 1900, 19300,   600,  1199, 18500,   600 },
+  {  3, 1800, 18050,  1200,  1949, 17100,   750 },
+  {  4, 1700, 21100,  1950,  2399, 17100,   450 },
+  {  5,  850,  8690,  2400,  2649,  8240,   250 },
+  {  6,  800,  8750,  2650,  2749,  8300,   100 },
+  {  7, 2600, 26200,  2750,  3449, 25000,   700 },
+  {  8,  900,  9250,  3450,  3799,  8800,   350 },
+  {  9, 1800, 18449,  3800,  4149, 17499,   350 },
+  { 10, 1700, 21100,  4150,  4749, 17100,   600 },
+  { 11, 1500, 14759,  4750,  4949, 14279,   200 },
+  { 12,  700,  7290,  5010,  5179,  6990,   170 },
+  { 13,  700,  7460,  5180,  5279,  7770,   100 },
+  { 14,  700,  7580,  5280,  5379,  7880,   100 },
+  {  0,    0,     0,     0,     0,     0,     0 },
+  {  0,    0,     0,     0,     0,     0,     0 },
+  { 17,  700,  7340,  5730,  5849,  7040,   120 },
+  { 18,  800,  8600,  5850,  5999,  8150,   150 },
+  { 19,  800,  8750,  6000,  6149,  8300,   150 },
+  { 20,  800,  7910,  6150,  6449,  8320,   300 },
+  { 21, 1500, 14959,  6450,  6599, 14479,   150 },
+  { 22, 3500, 35100,  6600,  7399, 34100,   800 },
+  { 23, 2000, 21800,  7500,  7699, 20000,   200 },
+  { 24, 1600, 15250,  7700,  8039, 16265,   340 },
+  { 25, 1900, 19300,  8040,  8689, 18500,   650 },
+  { 26,  850,  8590,  8690,  9039,  8140,   350 },
+  { 27,  800,  8520,  9040,  9209,  8070,   170 },
+  { 28,  700,  7580,  9210,  9659,  7030,   450 },
+  { 29,  700,  7170,  9660,  9769,     0,     0 },
+  { 30, 2300, 23500,  9770,  9869, 23050,   100 },
+  { 31,  450,  4625,  9870,  9919,  4525,    50 },
+  { 32, 1500, 14520,  9920, 10359,     0,     0 },
+  { 33, 1900, 19000, 36000, 36199, 19000,   200 },
+  { 34, 2000, 20100, 36200, 36349, 20100,   150 },
+  { 35, 1900, 18500, 36350, 36949, 18500,   600 },
+  { 36, 1900, 19300, 36950, 37549, 19300,   600 },
+  { 37, 1900, 19100, 37550, 37749, 19100,   200 },
+  { 38, 2600, 25700, 37750, 38249, 25700,   500 },
+  { 39, 1900, 18800, 38250, 38649, 18800,   400 },
+  { 40, 2300, 23000, 38650, 39649, 23000,  1000 },
+  { 41, 2500, 24960, 39650, 41589, 24960,  1940 },
+  { 42, 3500, 34000, 41590, 43589, 34000,  2000 },
+  { 43, 3700, 36000, 43590, 45589, 36000,  2000 },
+  { 44,  700,  7030, 45590, 46589,  7030,  1000 },
+  { 45, 1500, 14470, 46590, 46789, 14470,   200 },
+  { 46, 5200, 51500, 46790, 54539, 51500,  7750 },
+  { 47, 5900, 58550, 54540, 55239, 58550,   700 },
+  { 48, 3600, 35500, 55240, 56739, 35500,  1500 },
+  { 49, 3600, 35500, 56740, 58239, 35500,  1500 },
+  { 50, 1500, 14320, 58240, 59089, 14320,   850 },
+  { 51, 1500, 14270, 59090, 59139, 14270,    50 },
+  { 52, 3300, 33000, 59140, 60139, 33000,  1000 },
+  { 53, 2500, 24835, 60140, 60254, 24835,   115 },
+  {  0,    0,     0,     0,     0,     0,     0 },
+  {  0,    0,     0,     0,     0,     0,     0 },
+  {  0,    0,     0,     0,     0,     0,     0 },
+  {  0,    0,     0,     0,     0,     0,     0 },
+  {  0,    0,     0,     0,     0,     0,     0 },
+  {  0,    0,     0,     0,     0,     0,     0 },
+  {  0,    0,     0,     0,     0,     0,     0 },
+  {  0,    0,     0,     0,     0,     0,     0 },
+  {  0,    0,     0,     0,     0,     0,     0 },
+  {  0,    0,     0,     0,     0,     0,     0 },
+  {  0,    0,     0,     0,     0,     0,     0 },
+  { 65, 2100, 21100, 65536, 66435, 19200,   900 },
+  { 66, 1700, 21100, 66436, 67335, 17100,   700 },
+  { 67,  700,  7380, 67336, 67535,     0,     0 },
+  { 68,  700,  7530, 67536, 67835,  6980,   300 },
+  { 69, 2600, 25700, 67836, 68335,     0,     0 },
+  { 70, 2000, 19950, 68336, 68585, 16950,   150 },
+  { 71,  600,  6170, 68586, 68935,  6630,   350 },
+  { 72,  450,  4610, 68936, 68985,  4510,    50 },
+  { 73,  450,  4600, 68986, 69035,  4500,    50 },
+  { 74, 1500, 14750, 69036, 69465, 14270,   430 },
+  { 75, 1500, 14320, 69466, 70315,     0,     0 },
+  { 76, 1500, 14270, 70316, 70365,     0,     0 },
+  {  0,    0,     0,     0,     0,     0,     0 },
+  {  0,    0,     0,     0,     0,     0,     0 },
+  {  0,    0,     0,     0,     0,     0,     0 },
+  {  0,    0,     0,     0,     0,     0,     0 },
+  {  0,    0,     0,     0,     0,     0,     0 },
+  {  0,    0,     0,     0,     0,     0,     0 },
+  {  0,    0,     0,     0,     0,     0,     0 },
+  {  0,    0,     0,     0,     0,     0,     0 },
+  { 85,  700,  7280, 70366, 70545,  6980,   180 },
+  {  0,    0,     0,     0,     0,     0,     0 },
+  { 87,  410,  4200, 70546, 70595,  4100,    50 },
+  { 88,  410,  4220, 70596, 70645,  4120,    50 },
+};
+
+static_assert(lteBands[88].Band == 88, "lteBands[] must be indexed by band number");
+
+// 3GPP TS 25.101 UTRA FDD bands.
+// F_DL = UARFCN * 2 + DLOffset, F_UL = F_DL - Duplex.
+
+struct UTRABand {
+  uint8_t Band;
+  uint16_t NominalMHz;
+  int32_t First;
+  int32_t Last;
+  int32_t DLOffset;
+  int32_t Duplex;
+};
+
+constexpr UTRABand utraBands[] = {
+  {  1, 2100, 10562, 10838,     0, 1900 },
+  {  2, 1900,  9662,  9938,     0,  800 },
+  {  3, 1800,  1162,  1513, 15750,  950 },
+  {  4, 1700,  1537,  1738, 18050, 4000 },
+  {  5,  850,  4357,  4458,     0,  450 },
+  {  6,  800,  4387,  4413,     0,  450 },
+  {  7, 2600,  2237,  2563, 21750, 1200 },
+  {  8,  900,  2937,  3088,  3400,  450 },
+  {  9, 1800,  9237,  9387,     0,  950 },
+  { 10, 1700,  3112,  3388, 14900, 4000 },
+  { 11, 1500,  3712,  3787,  7360,  480 },
+  { 12,  700,  3842,  3903,  -370,  300 },
+  { 13,  700,  4017,  4043,  -550, -310 },
+  { 14,  700,  4117,  4143,  -630, -300 },
+  { 19,  800,   712,   763,  7350,  450 },
+  { 20,  800,  4512,  4638, -1090, -410 },
+  { 21, 1500,   862,   912, 13260,  480 },
+  { 22, 3500,  4662,  5038, 25800, 1000 },
+  { 25, 1900,  5112,  5413,  9100,  800 },
+  { 26,  850,  5762,  5913, -2910,  450 }
+};
+
+// 3GPP TS 45.005 GSM bands, 200 kHz channel raster.
+// F_UL = ULFirst + (ARFCN - First) * 2, F_DL = F_UL + Duplex.
+// ARFCN 512-810 is ambiguous (DCS 1800 / PCS 1900), DCS 1800 is assumed.
+
+struct GSMBand {
+  uint16_t NominalMHz;
+  int32_t First;
+  int32_t Last;
+  int32_t ULFirst;
+  int32_t Duplex;
+};
+
+constexpr GSMBand gsmBands[] = {
+  {  900,   0,  124,  8900, 450 },
+  {  900, 975, 1023,  8802, 450 },
+  {  850, 128,  251,  8242, 450 },
+  { 1800, 512,  885, 17102, 950 }
+};
+
+template <typename T, size_t N>
+constexpr size_t countOf(const T (&)[N]) { return N; }
+
+// Nominal frequency of an LTE band, 0 if unknown
+uint16_t getLTENominalMHz(int band) {
+  if (band <= 0 || band >= int(countOf(lteBands)))
+    return 0;
+
+  return lteBands[band].NominalMHz;
+}
+
+bool getLTEChannelInfo(int band, int earfcn, ChannelInfo &info) {
+  if (band <= 0 || band >= int(countOf(lteBands)))
+    return false;
+
+  const LTEBand &b = lteBands[band];
+
+  if (!b.Band || earfcn < b.DLOffset || earfcn > b.DLLast)
+    return false;
+
+  info.Band = b.Band;
+  info.NominalMHz = b.NominalMHz;
+  info.DLFrequency = (b.DLLow + (earfcn - b.DLOffset)) * 100;
+  info.ULFrequency = earfcn - b.DLOffset < b.ULChannels
+                     ? (b.ULLow + (earfcn - b.DLOffset)) * 100 : 0;
+  info.Bandwidth = (b.DLLast - b.DLOffset + 1) * 100;
+  return true;
+}
+
+bool getUTRAChannelInfo(int uarfcn, ChannelInfo &info) {
+  for (const UTRABand &b : utraBands) {
+    if (uarfcn < b.First || uarfcn > b.Last)
+      continue;
+
+    info.Band = b.Band;
+    info.NominalMHz = b.NominalMHz;
+    info.DLFrequency = (uarfcn * 2 + b.DLOffset) * 100;
+    info.ULFrequency = info.DLFrequency - b.Duplex * 100;
+    info.Bandwidth = ((b.Last - b.First) * 2 + 50) * 100;
+    return true;
+  }
+
+  return false;
+}
+
+bool getGSMChannelInfo(int arfcn, ChannelInfo &info) {
+  for (const GSMBand &b : gsmBands) {
+    if (arfcn < b.First || arfcn > b.Last)
+      continue;
+
+    info.Band = 0;
+    info.NominalMHz = b.NominalMHz;
+    info.ULFrequency = (b.ULFirst + (arfcn - b.First) * 2) * 100;
+    info.DLFrequency = info.ULFrequency + b.Duplex * 100;
+    info.Bandwidth = (b.Last - b.First + 1) * 2 * 100;
+    return true;
+  }
+
+  return false;
+}
@@ -0,0 +1,29 @@
+#!/bin/bash
+#
+# Polls bench/mock_router.py with the ALLOC_CHECK build and --backfill
+# while the syslog grows from LOG to the router's 200 KiB rotation size,
+# with a burst of new lines every 5 seconds. None of it may allocate after
+# warm-up. Run by bench/run.sh.
+#
+# usage: alloc_check.sh LOG [SECONDS] [PORT]
+
+set -e
+
+cd "$(dirname "$0")"
+
+LOG=$1
+SECONDS_PER_RUN=${2:-20}
+PORT=${3:-18081}
+
+python3 mock_router.py "$PORT" "$LOG" --grow 4000 --cap 204800 --burst 50 &
+MOCK=$!
+sleep 1
+kill -0 $MOCK
+trap 'kill $MOCK' EXIT
+
+# libcurl is not covered by ALLOC_CHECK, see zte_mf283plus_watch.cpp
+timeout -s INT --preserve-status "$SECONDS_PER_RUN" ./3wg3-watch_alloc_check \
+  --router-ip "127.0.0.1:$PORT" --router-password bench --transport builtin \
+  --update-interval 100 --backfill --pipe > /dev/null
+
+echo "alloc-check: no allocations after warm-up"
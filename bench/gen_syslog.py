@@ -0,0 +1,95 @@
+#!/usr/bin/env python3
+#
+# Writes a synthetic router syslog of about SIZE MB: 25% records parsed by
+# parseLine() (network type, signal, CSQ, provider, cell info, LAC), 75%
+# lines of other daemons, some of them containing marker bytes.
+# Timestamps start on Jan 31 23:00 and advance by 1-10 seconds per record
+# group, so logs of a few MB already span several days and a month change.
+#
+# usage: gen_syslog.py SIZE_MB OUTPUT [SEED]
+
+import random
+import sys
+import time
+
+MONTHS = ["Jan", "Feb", "Mar", "Apr", "May", "Jun",
+          "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"]
+
+NOISE = [
+    "daemon.info dnsmasq-dhcp[812]: DHCPACK(br0) 192.168.0.{n} 00:11:22:33:44:{n:02x}",
+    "daemon.info dnsmasq[812]: query[A] example.org from 192.168.0.{n}",
+    "kernel: br0: port 1(eth0) entered forwarding state",
+    "daemon.notice pppd[1043]: PPP connection established, LCP up",
+    "user.info goahead: Login from LAN client 192.168.0.{n}",
+    "kernel: nf_conntrack: table full, dropping packet {n}",
+    "daemon.info ntpclient: time adjusted by {n} ms",
+]
+
+
+class Log:
+    def __init__(self, seed):
+        self.rng = random.Random(seed)
+        self.time = time.mktime((2016, 1, 31, 23, 0, 0, 0, 0, -1))
+        self.rat = "LTE"
+
+    def stamp(self):
+        t = time.localtime(self.time)
+        return "%s %2d %02d:%02d:%02d 3WebGate" % (
+            MONTHS[t.tm_mon - 1], t.tm_mday, t.tm_hour, t.tm_min, t.tm_sec)
+
+    def record(self):
+        rng = self.rng
+        kind = rng.randrange(7)
+
+        if kind == 0:
+            self.rat = rng.choice(["LTE", "LTE", "WCDMA", "DC-HSPA+", "EDGE"])
+            return "user.info atserver: ProcAtZrssiRes network_type = %s, sub = 0" % self.rat
+        if kind == 1:
+            if self.rat == "LTE":
+                return "user.info atserver: rcv +ZRSSI: %d,%d,%d,%.1f" % (
+                    rng.randint(-120, -70), rng.randint(-20, -3), rng.randint(-90, -50),
+                    rng.uniform(-5, 30))
+            if self.rat == "EDGE":
+                return "user.info atserver: rcv +ZRSSI: %d" % rng.randint(-110, -50)
+            return "user.info atserver: rcv +ZRSSI: %d,%.1f" % (
+                rng.randint(-115, -60), rng.uniform(-20, -2))
+        if kind == 2:
+            return "user.info atserver: rcv +CSQ: %d,%d" % (rng.randint(0, 31), rng.choice([0, 99]))
+        if kind == 3:
+            return "user.info atserver: rcv +ZDON: \"3 AT\",232,05"
+        if kind == 4:
+            return "user.info atserver: rcv +ZCELLINFO: %d, %d, LTE B%s, %d" % (
+                rng.randint(1, 1 << 27), rng.randint(0, 503), *rng.choice(
+                    [("3", rng.randint(1200, 1949)), ("7", rng.randint(2750, 3449)),
+                     ("20", rng.randint(6150, 6449))]))
+        if kind == 5:
+            return "user.info atserver: LAC=%x CELL_ID=%x" % (
+                rng.randint(1, 0xffff), rng.randint(1, 1 << 27))
+        return "user.info atserver: AT+ZPAS?^M^M +ZPAS: \"%s\",\"CS_PS\"" % rng.choice(
+            ["LTE", "UMTS", "GPRS"])
+
+    def line(self):
+        if self.rng.random() < 0.25:
+            self.time += self.rng.randint(1, 10)
+            return self.stamp() + " " + self.record()
+        noise = self.rng.choice(NOISE).format(n=self.rng.randint(2, 254))
+        return self.stamp() + " " + noise
+
+
+def main():
+    if len(sys.argv) < 3:
+        sys.exit("usage: gen_syslog.py SIZE_MB OUTPUT [SEED]")
+
+    size = int(float(sys.argv[1]) * 1024 * 1024)
+    log = Log(int(sys.argv[3]) if len(sys.argv) > 3 else 1)
+    written = 0
+
+    with open(sys.argv[2], "w") as out:
+        while written < size:
+            line = log.line() + "\n"
+            out.write(line)
+            written += len(line)
+
+
+if __name__ == "__main__":
+    main()
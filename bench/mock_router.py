@@ -0,0 +1,131 @@
+#!/usr/bin/env python3
+#
+# Minimal stand-in for the router's web interface: accepts any login,
+# serves a syslog on /messages and the JSON status API. HTTP/1.1 with
+# keep-alive, HEAD and suffix Range requests like the router's web server.
+#
+# usage: mock_router.py PORT LOG [--chunked] [--grow BYTES] [--cap BYTES] [--burst N]
+#
+# --grow appends BYTES of new log lines before every /messages response,
+# --cap drops the oldest lines beyond BYTES like the router's log rotation,
+# --burst appends 20 times as much every Nth response, like the first poll
+# after the router was unreachable for a while.
+
+import hashlib
+import http.server
+import json
+import sys
+import time
+
+STATUS = {
+    "network_type": "LTE", "network_provider": "3 AT", "rmcc": "232", "rmnc": "5",
+    "lte_rsrp": "-95", "lte_rsrq": "-11", "lte_rssi": "-61", "lte_snr": "12.5",
+    "cell_id": "12D687", "lac_code": "1F4", "lte_band": "3", "wan_active_channel": "1575",
+}
+
+
+class Log:
+    def __init__(self, path, grow, cap, burst):
+        with open(path, "rb") as f:
+            self.lines = f.read().splitlines(keepends=True)
+        self.data = b"".join(self.lines)
+        self.grow = grow
+        self.cap = cap
+        self.burst = burst
+        self.polls = 0
+        self.next = 0
+        self.clock = 0
+
+    def poll(self):
+        self.polls += 1
+        if self.grow:
+            grow = self.grow * 20 if self.burst and self.polls % self.burst == 0 else self.grow
+            added = []
+            size = 0
+            # Logged now, one second apart so that repeated lines stay
+            # distinct measurements
+            self.clock = max(self.clock + 1, int(time.time()))
+            while size < grow:
+                stamp = time.strftime("%b %e %H:%M:%S", time.localtime(self.clock)).encode()
+                self.clock += 1
+                line = stamp + self.lines[self.next % len(self.lines)][len(stamp):]
+                self.next += 1
+                added.append(line)
+                size += len(line)
+            self.data += b"".join(added)
+        if self.cap and len(self.data) > self.cap:
+            cut = self.data.index(b"\n", len(self.data) - self.cap) + 1
+            self.data = self.data[cut:]
+        return self.data
+
+
+class Handler(http.server.BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+
+    def log_message(self, *args):
+        pass
+
+    def send(self, body, status=200, headers=(), head=False):
+        self.send_response(status)
+        for name, value in headers:
+            self.send_header(name, value)
+        if self.server.chunked and not head and status == 200:
+            self.send_header("Transfer-Encoding", "chunked")
+            self.end_headers()
+            for i in range(0, len(body), 4096):
+                chunk = body[i:i + 4096]
+                self.wfile.write(b"%x\r\n%s\r\n" % (len(chunk), chunk))
+            self.wfile.write(b"0\r\n\r\n")
+            return
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        if not head:
+            self.wfile.write(body)
+
+    def messages(self, head):
+        data = self.server.log.poll() if not head else self.server.log.data
+        etag = ('"%s"' % hashlib.md5(data).hexdigest()[:16],)
+        range_ = self.headers.get("Range", "")
+        if range_.startswith("bytes=-") and not head:
+            tail = data[-int(range_[7:]):]
+            self.send(tail, 206, [("ETag", etag[0]), ("Content-Range", "bytes %d-%d/%d" % (
+                len(data) - len(tail), len(data) - 1, len(data)))])
+        else:
+            self.send(data, headers=[("ETag", etag[0])], head=head)
+
+    def do_HEAD(self):
+        if self.path.startswith("/messages"):
+            self.messages(True)
+        else:
+            self.send(b"", 404, head=True)
+
+    def do_GET(self):
+        if self.path.startswith("/messages"):
+            self.messages(False)
+        elif self.path.startswith("/goform/goform_get_cmd_process"):
+            self.send(json.dumps(STATUS).encode())
+        else:
+            self.send(b"<html></html>")
+
+    def do_POST(self):
+        self.rfile.read(int(self.headers.get("Content-Length", 0)))
+        self.send(b'{"result":"0"}')
+
+
+def main():
+    args = sys.argv[1:]
+    if len(args) < 2:
+        sys.exit("usage: mock_router.py PORT LOG [--chunked] [--grow BYTES] [--cap BYTES] [--burst N]")
+
+    def option(name):
+        return int(args[args.index(name) + 1]) if name in args else 0
+
+    server = http.server.ThreadingHTTPServer(("127.0.0.1", int(args[0])), Handler)
+    server.daemon_threads = True
+    server.chunked = "--chunked" in args
+    server.log = Log(args[1], option("--grow"), option("--cap"), option("--burst"))
+    server.serve_forever()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,395 @@
+/*
+  This is free and unencumbered software released into the public domain.
+
+  Anyone is free to copy, modify, publish, use, compile, sell, or
+  distribute this software, either in source code form or as a compiled
+  binary, for any purpose, commercial or non-commercial, and by any
+  means.
+
+  In jurisdictions that recognize copyright laws, the author or authors
+  of this software dedicate any and all copyright interest in the
+  software to the public domain. We make this dedication for the benefit
+  of the public at large and to the detriment of our heirs and
+  successors. We intend this dedication to be an overt act of
+  relinquishment in perpetuity of all present and future rights to this
+  software under copyright law.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+  OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+  OTHER DEALINGS IN THE SOFTWARE.
+
+  For more information, please refer to <http://unlicense.org/>
+*/
+
+// Checks and benchmarks of the syslog parser, built by BENCH=1 ./compile.sh
+// and run by bench/run.sh. Includes the library source to reach its
+// internals.
+//
+// usage: parse_bench check-scanners [BUFFERS]
+//        parse_bench check-parse LOG [WINDOWS]
+//        parse_bench check-parallel LOG [WINDOWS]
+//        parse_bench bench LOG [RUNS]
+
+#include "../zte_mf283plus_watch.cpp"
+
+#include <random>
+
+using namespace zte_mf283plus_watch;
+
+namespace {
+
+bool readFile(const char *path, std::string &data) {
+  FILE *f = fopen(path, "rb");
+  char buf[65536];
+  size_t n;
+
+  if (!f)
+    return false;
+
+  data.clear();
+
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+    data.append(buf, n);
+
+  fclose(f);
+  return true;
+}
+
+// Random window of at least minSize bytes, starting and ending at line
+// boundaries
+void randomWindow(const std::string &log, std::mt19937 &rng, size_t minSize, size_t maxSize,
+                  const char *&begin, const char *&end) {
+  size_t size = std::min(log.size(), minSize + rng() % (maxSize - minSize + 1));
+  size_t start = rng() % (log.size() - size + 1);
+
+  while (start > 0 && log[start - 1] != '\n')
+    --start;
+
+  begin = log.data() + start;
+  end = begin + std::min(size, log.size() - start);
+
+  while (end < log.data() + log.size() && end[-1] != '\n')
+    ++end;
+}
+
+// Every scanner of scan.h this CPU can run has to split random buffers
+// exactly like the scalar one, from every start offset and in both
+// directions. Built on AArch64 this covers NEON.
+bool checkScanners(int buffers) {
+  const char alphabet[] = "abc\n+LPx \n\nyz";
+  std::mt19937 rng(38);
+  std::string buf;
+  unsigned long checks = 0, failed = 0;
+
+  for (int i = 0; i < buffers; ++i) {
+    // Mostly plain bytes, with newlines and markers of varying density
+    size_t length = rng() % 200;
+    unsigned density = rng() % 4 * 20 + 2;
+
+    buf.assign(length, 'q');
+
+    for (char &c : buf) {
+      if (rng() % density == 0)
+        c = alphabet[rng() % (sizeof(alphabet) - 1)];
+    }
+
+    const char *begin = buf.data(), *end = begin + length;
+
+    for (size_t offset = 0; offset <= length; ++offset) {
+      bool forwardMarker = false, reverseMarker = false;
+      const char *forward = scanForwardScalar(begin + offset, end, forwardMarker);
+      const char *reverse = scanReverseScalar(begin, begin + offset, reverseMarker);
+
+      for (const LineScanner &scanner : lineScanners) {
+        if (!scanner.Supported())
+          continue;
+
+        bool f = false, r = false;
+        ++checks;
+
+        if (scanner.Forward(begin + offset, end, f) != forward || f != forwardMarker ||
+            scanner.Reverse(begin, begin + offset, r) != reverse || r != reverseMarker) {
+          if (failed++ < 5)
+            fprintf(stderr, "check-scanners: %s differs, %zu bytes at offset %zu\n",
+                    scanner.Name, length, offset);
+        }
+      }
+    }
+  }
+
+  printf("check-scanners:");
+
+  for (const LineScanner &scanner : lineScanners) {
+    if (scanner.Supported())
+      printf(" %s", scanner.Name);
+  }
+
+  printf(", %lu checks, %lu mismatches\n", checks, failed);
+  return !failed;
+}
+
+// The forward parse loop as it was before scan.h: every line is copied
+// and run through parseLine(). The reverse parse has to give the same.
+
+template <size_t N>
+bool referenceGetLine(const char *&str, const char *end, char (&buf)[N]) {
+  if (str == end)
+    return false;
+
+  const char *start = str;
+
+  while (str < end && *str++ != '\n');
+
+  const char *lineEnd = str[-1] == '\n' ? str - 1 : str;
+
+  size_t length = std::min<size_t>(N - 1, lineEnd - start);
+  memcpy(buf, start, length);
+  buf[length] = '\0';
+  return true;
+}
+
+void referenceForward(const char *m, const char *end, Info &info, ParseState &state) {
+  char line[4096];
+
+  while (referenceGetLine(m, end, line)) {
+    unsigned groups = parseLine(line, info);
+
+    if (groups & GROUP_SIGNAL)
+      state.routerTime = parseSyslogTime(line, state.date);
+
+    if (groups & GROUP_NETWORK_TYPE)
+      state.networkTypeTime = parseSyslogTime(line, state.date);
+  }
+}
+
+typedef void (*ParseFunction)(const char *m, const char *end, Info &info, ParseState &state);
+
+// Parses from garbage, so that bytes one of the parses does not set differ
+void parseFromGarbage(ParseFunction parse, const char *begin, const char *end,
+                      Info &info, ParseState &state) {
+  memset((void *)&info, 0x5a, sizeof(info));
+  info.reset();
+  state.reset();
+  parse(begin, end, info, state);
+}
+
+bool sameResult(const Info &a, const ParseState &aState, const Info &b, const ParseState &bState) {
+  return !memcmp(&a, &b, sizeof(a)) && aState.routerTime == bState.routerTime &&
+         aState.networkTypeTime == bState.networkTypeTime;
+}
+
+// Skipping the lines without a marker byte must not change the result of
+// either parse direction, with any scanner. Half of the windows end in the
+// middle of a line.
+bool checkParse(const std::string &log, int windows) {
+  std::mt19937 rng(380);
+  unsigned runs = 0, failed = 0;
+  LineScanner selected = lineScanner;
+
+  for (int i = 0; i < windows; ++i) {
+    const char *begin, *end;
+    randomWindow(log, rng, 1024, 1 << 20, begin, end);
+
+    if (rng() % 2)
+      end -= std::min<size_t>(end - begin, rng() % 64);
+
+    Info expected, actual;
+    ParseState expectedState, actualState;
+
+    parseFromGarbage(referenceForward, begin, end, expected, expectedState);
+
+    for (int reverse = 0; reverse < 2; ++reverse) {
+      for (const LineScanner &scanner : lineScanners) {
+        if (!scanner.Supported())
+          continue;
+
+        lineScanner = scanner;
+        parseFromGarbage(reverse ? parseMessagesReverse : parseMessagesForward, begin, end,
+                         actual, actualState);
+        ++runs;
+
+        if (!sameResult(expected, expectedState, actual, actualState) && failed++ < 5)
+          fprintf(stderr, "check-parse: %s %s parse differs, %zu bytes at offset %zu\n",
+                  scanner.Name, reverse ? "reverse" : "forward", size_t(end - begin),
+                  size_t(begin - log.data()));
+      }
+    }
+  }
+
+  lineScanner = selected;
+  printf("check-parse: %u runs, %u mismatches\n", runs, failed);
+  return !failed;
+}
+
+// One line of every group, two of them written twice. The reverse parse
+// has to give the forward result in every order they can be logged in,
+// e.g. LAC= older than the +ZCELLINFO that also writes the cell ID.
+const char *const ORDER_RECORDS[] = {
+  "user.info atserver: LAC=1a2b CELL_ID=12d687",
+  "user.info atserver: ProcAtZrssiRes network_type = LTE, sub = 0",
+  "user.info atserver: rcv +ZCELLINFO: 1234568, 100, LTE B3, 1575",
+  "user.info atserver: rcv +ZCELLINFO: 1, 2, WCDMA 2100, 10700",
+  "user.info atserver: rcv +ZRSSI: -95,-11,-61,12.5",
+  "user.info atserver: rcv +ZRSSI: -80,-5.5",
+  "user.info atserver: rcv +CSQ: 20,99",
+  "user.info atserver: rcv +ZDON: \"3 AT\",232,05"
+};
+
+bool checkOrders() {
+  const size_t count = countOf(ORDER_RECORDS);
+  size_t order[count];
+  unsigned runs = 0, failed = 0;
+  std::string log;
+
+  for (size_t i = 0; i < count; ++i)
+    order[i] = i;
+
+  do {
+    char line[256];
+
+    log.clear();
+
+    for (size_t i = 0; i < count; ++i) {
+      snprintf(line, sizeof(line), "Jan 31 23:00:%02zu 3WebGate %s\n", i, ORDER_RECORDS[order[i]]);
+      log += line;
+    }
+
+    const char *begin = log.data(), *end = begin + log.size();
+    Info forward, reverse;
+    ParseState forwardState, reverseState;
+
+    parseFromGarbage(parseMessagesForward, begin, end, forward, forwardState);
+    parseFromGarbage(parseMessagesReverse, begin, end, reverse, reverseState);
+    ++runs;
+
+    if (!sameResult(forward, forwardState, reverse, reverseState) && failed++ < 5)
+      fprintf(stderr, "check-parse: reverse parse differs for\n%s", log.c_str());
+  } while (std::next_permutation(order, order + count));
+
+  printf("check-parse: %u record orders, %u mismatches\n", runs, failed);
+  return !failed;
+}
+
+// Forward parse of the whole log, best of runs
+double bestTime(ParseFunction parse, const std::string &log, int runs) {
+  double best = 1e30;
+
+  for (int i = 0; i < runs; ++i) {
+    Info info;
+    ParseState state;
+    info.reset();
+    state.reset();
+
+    auto start = std::chrono::steady_clock::now();
+    parse(log.data(), log.data() + log.size(), info, state);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    best = std::min(best, elapsed.count());
+  }
+
+  return best;
+}
+
+void bench(const std::string &log, int runs) {
+  double MB = log.size() / double(1 << 20);
+  double reference = bestTime(referenceForward, log, runs);
+  LineScanner selected = lineScanner;
+
+  printf("bench: %.0f MB forward parse, best of %d\n", MB, runs);
+  printf("  %-10s %7.0f MB/s\n", "reference", MB / reference);
+
+  for (const LineScanner &scanner : lineScanners) {
+    if (!scanner.Supported())
+      continue;
+
+    lineScanner = scanner;
+    double time = bestTime(parseMessagesForward, log, runs);
+    printf("  %-10s %7.0f MB/s  %.2fx\n", scanner.Name, MB / time, reference / time);
+  }
+
+  lineScanner = selected;
+}
+
+// OPT_PARSE_THREADS: the chunks merged in order have to give exactly what
+// the serial forward parse gives, byte for byte, including the syslog
+// times that drive the network switch handling of parseData()
+bool checkParallel(const std::string &log, int windows) {
+  std::mt19937 rng(39);
+  const unsigned threadCounts[] = { 2, 3, 4, 8 };
+  unsigned runs = 0, failed = 0;
+
+  for (int i = 0; i < windows; ++i) {
+    const char *begin, *end;
+    randomWindow(log, rng, 2 * MIN_CHUNK_SIZE, 4 << 20, begin, end);
+
+    for (unsigned threads : threadCounts) {
+      // Start from garbage, the merge has to overwrite every byte it set
+      Info serial, parallel;
+      memset((void *)&serial, 0x5a, sizeof(serial));
+      serial.reset();
+      memcpy(&parallel, &serial, sizeof(serial));
+
+      ParseState serialState, parallelState;
+      serialState.reset();
+      parallelState.reset();
+
+      parseMessagesForward(begin, end, serial, serialState);
+
+      if (!parsePool.parse(begin, end, parallel, parallelState, threads)) {
+        fprintf(stderr, "check-parallel: %zu bytes were not split\n", size_t(end - begin));
+        return false;
+      }
+
+      ++runs;
+
+      if (memcmp(&serial, &parallel, sizeof(serial)) ||
+          serialState.routerTime != parallelState.routerTime ||
+          serialState.networkTypeTime != parallelState.networkTypeTime) {
+        if (failed++ < 5)
+          fprintf(stderr, "check-parallel: mismatch with %u threads, %zu bytes at offset %zu\n",
+                  threads, size_t(end - begin), size_t(begin - log.data()));
+      }
+    }
+  }
+
+  parsePool.stop();
+  printf("check-parallel: %u runs, %u mismatches\n", runs, failed);
+  return !failed;
+}
+
+} // unnamed namespace
+
+int main(int argc, char **argv) {
+  std::string log;
+
+  if (argc >= 2 && !strcmp(argv[1], "check-scanners"))
+    return checkScanners(argc > 2 ? atoi(argv[2]) : 20000) ? 0 : 1;
+
+  if (argc < 3 || !readFile(argv[2], log)) {
+    fprintf(stderr, "usage: %s check-scanners [BUFFERS]\n"
+                    "       %s check-parse LOG [WINDOWS]\n"
+                    "       %s check-parallel LOG [WINDOWS]\n"
+                    "       %s bench LOG [RUNS]\n", argv[0], argv[0], argv[0], argv[0]);
+    return 2;
+  }
+
+  if (!strcmp(argv[1], "check-parse")) {
+    bool ok = checkOrders();
+    return checkParse(log, argc > 3 ? atoi(argv[3]) : 200) && ok ? 0 : 1;
+  }
+
+  if (!strcmp(argv[1], "check-parallel"))
+    return checkParallel(log, argc > 3 ? atoi(argv[3]) : 60) ? 0 : 1;
+
+  if (!strcmp(argv[1], "bench")) {
+    bench(log, argc > 3 ? atoi(argv[3]) : 3);
+    return 0;
+  }
+
+  fprintf(stderr, "Unknown command %s\n", argv[1]);
+  return 2;
+}
@@ -0,0 +1,38 @@
+#!/bin/bash
+#
+# Checks and benchmarks, run by BENCH=1 ./compile.sh after building
+# bench/parse_bench. Needs python3 for the synthetic syslogs.
+
+set -e
+
+cd "$(dirname "$0")"
+
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+python3 gen_syslog.py 10 "$TMP/10mb.log"
+python3 gen_syslog.py 100 "$TMP/100mb.log"
+
+# Vectorized line scanners vs scalar, and the parse with each of them vs
+# the copy-every-line parse
+./parse_bench check-scanners
+./parse_bench check-parse "$TMP/10mb.log"
+
+# Serial vs parallel parse, also under ThreadSanitizer if it got built
+./parse_bench check-parallel "$TMP/10mb.log"
+
+if [ -x parse_bench_tsan ]; then
+  ./parse_bench_tsan check-parallel "$TMP/10mb.log" 6
+fi
+
+./parse_bench bench "$TMP/10mb.log" 5
+./parse_bench bench "$TMP/100mb.log"
+
+# Poll latency of both transports against a mock router serving a log of
+# typical size
+python3 gen_syslog.py 0.2 "$TMP/router.log"
+./transport_bench.sh "$TMP/router.log"
+
+# No allocations while the syslog grows up to the router's rotation size
+python3 gen_syslog.py 0.02 "$TMP/small.log"
+./alloc_check.sh "$TMP/small.log"
@@ -0,0 +1,40 @@
+#!/bin/bash
+#
+# Side-by-side poll latency of the curl and built-in transports against
+# bench/mock_router.py, polling every 100 ms. Run by bench/run.sh, needs
+# the 3wg3-watch binary built by compile.sh.
+#
+# usage: transport_bench.sh LOG [SECONDS] [PORT]
+
+set -e
+
+cd "$(dirname "$0")"
+
+LOG=$1
+SECONDS_PER_RUN=${2:-10}
+PORT=${3:-18080}
+
+# A few new lines before every response so that no poll is skipped as
+# unchanged, rotated at the initial size like the router's log
+python3 mock_router.py "$PORT" "$LOG" --grow 500 --cap "$(wc -c < "$LOG")" &
+MOCK=$!
+sleep 1
+kill -0 $MOCK
+trap 'kill $MOCK' EXIT
+
+printf "%-8s %-22s %-22s\n" transport "HTTP p50/p99/max ms" "Poll p50/p99/max ms"
+
+for transport in curl builtin; do
+  out=$(timeout -s INT "$SECONDS_PER_RUN" ../3wg3-watch --router-ip "127.0.0.1:$PORT" \
+        --router-password bench --transport $transport --update-interval 100 --pipe --stats \
+        2>&1 | tail -n 1) || true
+
+  if [[ "$out" == *"not available"* ]]; then
+    printf "%-8s not available in this build\n" $transport
+    continue
+  fi
+
+  printf "%-8s %-22s %-22s\n" $transport \
+    "$(grep -o 'HTTP [0-9./]*' <<< "$out" | cut -d' ' -f2)" \
+    "$(grep -o 'Poll [0-9./]*' <<< "$out" | cut -d' ' -f2)"
+done
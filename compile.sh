@@ -30,6 +30,19 @@ fi
 
 CXXFLAGS+=" -Wall -Wextra -Wno-unused-function -Wformat -Wformat-security"
 
+# ALLOC_CHECK=1: abort on heap allocations of the update thread after warm-up
+if [ -n "$ALLOC_CHECK" ]; then
+  CXXFLAGS+=" -DALLOC_CHECK"
+fi
+
+# NO_CURL=1: use the built-in HTTP client only and do not link libcurl
+if [ -n "$NO_CURL" ]; then
+  CXXFLAGS+=" -DNO_CURL"
+  LIBCURL=""
+else
+  LIBCURL="-lcurl"
+fi
+
 if [ -n "$DEBUG" ]; then
   CXXFLAGS+=" -g"
 else
@@ -47,10 +60,24 @@ if [ -n "$HOSTPREFIX" ]; then
 fi
 
 rm -f *.o *.a *.so 3wg3-watch{,.exe} libzte_mf283plus_watch$SUFFIX{.a,.dll,.dylib,.dll}
+rm -f bench/parse_bench{,_tsan,.exe} bench/3wg3-watch_alloc_check{,.exe}
 
 $CXX zte_mf283plus_watch.cpp -fpic $CXXFLAGS $INCPATHS -std=c++11 -c
 $CXX main.cpp $CXXFLAGS $INCPATHS -std=c++11 -c
 
 $AR rcs  libzte_mf283plus_watch$SUFFIX.a zte_mf283plus_watch.o
-$CXX zte_mf283plus_watch.o -shared -pthread $CXXFLAGS $INCPATHS -lcurl $LDFLAGS -o libzte_mf283plus_watch$SUFFIX$DLLSUFFIX
-$CXX main.o libzte_mf283plus_watch$SUFFIX.a -pthread $INCPATHS -lcurl $LDFLAGS -o 3wg3-watch$SUFFIX$EXESUFFIX
+$CXX zte_mf283plus_watch.o -shared -pthread $CXXFLAGS $INCPATHS $LIBCURL $LDFLAGS -o libzte_mf283plus_watch$SUFFIX$DLLSUFFIX
+$CXX main.o libzte_mf283plus_watch$SUFFIX.a -pthread $INCPATHS $LIBCURL $LDFLAGS -o 3wg3-watch$SUFFIX$EXESUFFIX
+
+# BENCH=1: build the parser checks and benchmarks and run bench/run.sh
+if [ -n "$BENCH" ]; then
+  $CXX bench/parse_bench.cpp $CXXFLAGS $INCPATHS -std=c++11 -pthread $LIBCURL $LDFLAGS -o bench/parse_bench$EXESUFFIX
+
+  if [ "$TARGET" == "Linux" ]; then
+    $CXX bench/parse_bench.cpp ${CXXFLAGS/-O2/-O1} -g -fsanitize=thread $INCPATHS -std=c++11 -pthread $LIBCURL -o bench/parse_bench_tsan
+  fi
+
+  $CXX main.cpp zte_mf283plus_watch.cpp $CXXFLAGS -DALLOC_CHECK $INCPATHS -std=c++11 -pthread $LIBCURL $LDFLAGS -o bench/3wg3-watch_alloc_check$EXESUFFIX
+
+  bench/run.sh
+fi
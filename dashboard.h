@@ -0,0 +1,301 @@
+/*
+  This is free and unencumbered software released into the public domain.
+
+  Anyone is free to copy, modify, publish, use, compile, sell, or
+  distribute this software, either in source code form or as a compiled
+  binary, for any purpose, commercial or non-commercial, and by any
+  means.
+
+  In jurisdictions that recognize copyright laws, the author or authors
+  of this software dedicate any and all copyright interest in the
+  software to the public domain. We make this dedication for the benefit
+  of the public at large and to the detriment of our heirs and
+  successors. We intend this dedication to be an overt act of
+  relinquishment in perpetuity of all present and future rights to this
+  software under copyright law.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+  OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+  OTHER DEALINGS IN THE SOFTWARE.
+
+  For more information, please refer to <http://unlicense.org/>
+*/
+
+// Full-screen dashboard of the CLI (--dashboard).
+// Included into an unnamed namespace by main.cpp.
+// Every metric keeps a fixed ring of time buckets, one per sparkline
+// column. A heartbeat only updates the bucket of the current column, so
+// the cost per frame does not depend on the update rate.
+
+const int SPARKLINE_COLUMNS = 60;
+const int64_t SPARKLINE_BUCKET_NS = 5 * 1000000000LL; // 5 minutes in total
+const size_t DASHBOARD_EVENTS = 8;
+
+#ifdef _WIN32
+const char *const sparklineLevels[] = { "_", ".", ":", "-", "=", "+", "*", "#" };
+#else
+const char *const sparklineLevels[] = { "▁", "▂", "▃", "▄", "▅", "▆", "▇", "█" };
+#endif
+
+float toFloat(int16_t value) {
+  return value != INFO_V2_NOT_AVAILABLE ? float(value) : NAN;
+}
+
+struct DashboardMetric {
+  const char *name;
+  const char *unit;
+  float low, high;     // scale of the sparkline
+  uint8_t generations; // bit per generation it is shown for
+  float (*get)(const zte_mf283plus_watch::InfoV2 &info);
+};
+
+const DashboardMetric dashboardMetrics[] = {
+  { "RSRP", "dBm", -140.f, -44.f, 1 << 4,
+    [](const zte_mf283plus_watch::InfoV2 &info) { return toFloat(info.RSRP); } },
+  { "RSRQ", "dB", -20.f, -3.f, 1 << 4,
+    [](const zte_mf283plus_watch::InfoV2 &info) { return toFloat(info.RSRQ); } },
+  { "SINR", "dB", -10.f, 30.f, 1 << 4,
+    [](const zte_mf283plus_watch::InfoV2 &info) { return info.SINR; } },
+  { "RSCP", "dBm", -120.f, -25.f, 1 << 3,
+    [](const zte_mf283plus_watch::InfoV2 &info) { return toFloat(info.RSCP); } },
+  { "EC/IO", "dB", -24.f, 0.f, 1 << 3,
+    [](const zte_mf283plus_watch::InfoV2 &info) { return info.ECIO; } },
+  { "RSSI", "dBm", -110.f, -50.f, 1 << 4 | 1 << 2,
+    [](const zte_mf283plus_watch::InfoV2 &info) { return toFloat(info.RSSI); } },
+  { "CSQ", "", 0.f, 31.f, 1 << 4 | 1 << 3 | 1 << 2,
+    [](const zte_mf283plus_watch::InfoV2 &info) { return info.CSQ; } }
+};
+
+const size_t DASHBOARD_METRICS = sizeof(dashboardMetrics) / sizeof(dashboardMetrics[0]);
+
+class Dashboard {
+public:
+  explicit Dashboard(int updateInterval) : updateInterval(updateInterval) {}
+
+  // Feeds every heartbeat into the sparklines and logs cell changes
+  void update(zte_mf283plus_watch::Info &info, bool testMode) {
+    using namespace zte_mf283plus_watch;
+
+    InfoV2 v2;
+    int64_t now = getMonotonicTime();
+
+    if (testMode) {
+      fakeGetInfo(info);
+      convertInfo(info, v2);
+    } else {
+      Heartbeat heartbeat;
+
+      if (!getHeartbeat(heartbeat) || !getInfoV2(v2))
+        return;
+
+      checkStall(now, heartbeat);
+
+      if (heartbeat.Count == beats)
+        return;
+
+      beats = heartbeat.Count;
+      now = heartbeat.LastMono;
+    }
+
+    if (v2.N != current.N)
+      logChanges(v2);
+
+    current = v2;
+    valid = true;
+
+    // Cached values of another RAT are not measurements
+    if (v2.Present & INFO_STALE)
+      return;
+
+    int64_t index = now / SPARKLINE_BUCKET_NS;
+
+    for (size_t i = 0; i < DASHBOARD_METRICS; ++i) {
+      float value = dashboardMetrics[i].get(v2);
+
+      if (!std::isnan(value))
+        buckets[i][index % SPARKLINE_COLUMNS].add(index, value, dashboardMetrics[i]);
+    }
+  }
+
+  void render(Renderer &renderer, double age) {
+    using namespace zte_mf283plus_watch;
+
+    if (!valid)
+      return;
+
+    const NetworkTypeInfo &networkType = getNetworkTypeInfo(NetworkTypeID(current.NetworkType));
+    int64_t index = getMonotonicTime() / SPARKLINE_BUCKET_NS;
+    size_t len = 0;
+
+    frame[0] = '\0';
+    appendf(frame, sizeof(frame), len, "[%s", networkType.Name);
+    if (current.Present & INFO_HAS_PROVIDER_INFO)
+      appendf(frame, sizeof(frame), len, " | %s (%d)", getProviderName(current.ProviderID), current.MCCMNC);
+
+    if (current.Band)
+      appendf(frame, sizeof(frame), len, " | Band %d, DL %.1f MHz, UL %.1f MHz",
+              current.Band, current.DLFrequency / 1000.0, current.ULFrequency / 1000.0);
+    if (current.Present & INFO_HAS_CHANNEL)
+      appendf(frame, sizeof(frame), len, " | Channel %d", current.Channel);
+
+    appendf(frame, sizeof(frame), len, "]");
+    if (current.Present & INFO_HAS_CELL_ID)
+      appendf(frame, sizeof(frame), len, " [CELL ID: %X]", current.GlobalCellID);
+    if (current.Present & INFO_HAS_LAC)
+      appendf(frame, sizeof(frame), len, " [LAC: %d]", current.LAC);
+    appendf(frame, sizeof(frame), len, " [%.1fs]%s\n\n", age,
+            (current.Present & INFO_STALE) ? " [Cached]" : "");
+
+    for (size_t i = 0; i < DASHBOARD_METRICS; ++i) {
+      const DashboardMetric &metric = dashboardMetrics[i];
+
+      if (!(metric.generations & (1 << networkType.Generation)))
+        continue;
+
+      renderMetric(i, index, len);
+    }
+
+    if (!networkType.Generation)
+      appendf(frame, sizeof(frame), len, "No Service!\n");
+
+    appendf(frame, sizeof(frame), len, "\n%*s%-*s%s max/min/avg\n\n", 17, "",
+            SPARKLINE_COLUMNS - 3, "-5 min", "now");
+    appendf(frame, sizeof(frame), len, "Events:\n");
+
+    size_t count = std::min(eventCount, DASHBOARD_EVENTS);
+
+    for (size_t i = eventCount - count; i < eventCount; ++i)
+      appendf(frame, sizeof(frame), len, "%s\n", events[i % DASHBOARD_EVENTS]);
+
+    if (noClearScreen) {
+      printf("%s\n", frame);
+      fflush(stdout);
+    } else {
+      renderer.render(frame);
+    }
+  }
+
+private:
+  struct Bucket {
+    int64_t index = -1; // Absolute bucket number, -1: empty
+    float min, max;
+    double sum;
+    uint32_t count;
+    uint8_t level;
+
+    void add(int64_t bucketIndex, float value, const DashboardMetric &metric) {
+      if (index != bucketIndex) {
+        index = bucketIndex;
+        min = max = value;
+        sum = 0.0;
+        count = 0;
+      }
+
+      min = std::min(min, value);
+      max = std::max(max, value);
+      sum += value;
+      ++count;
+
+      float scaled = (float(sum / count) - metric.low) / (metric.high - metric.low) * 8.f;
+      level = uint8_t(std::min(std::max(int(scaled), 0), 7));
+    }
+  };
+
+  void renderMetric(size_t metric, int64_t index, size_t &len) {
+    const DashboardMetric &definition = dashboardMetrics[metric];
+    float value = definition.get(current);
+    float min = INFINITY, max = -INFINITY;
+    double sum = 0.0;
+    uint32_t count = 0;
+
+    if (std::isnan(value))
+      appendf(frame, sizeof(frame), len, "%-6s %5s %-3s ", definition.name, "n/a", definition.unit);
+    else
+      appendf(frame, sizeof(frame), len, "%-6s %5.1f %-3s ", definition.name, value, definition.unit);
+
+    for (int64_t i = index - SPARKLINE_COLUMNS + 1; i <= index; ++i) {
+      if (i < 0) {
+        appendf(frame, sizeof(frame), len, " ");
+        continue;
+      }
+
+      const Bucket &bucket = buckets[metric][i % SPARKLINE_COLUMNS];
+
+      if (bucket.index != i) {
+        appendf(frame, sizeof(frame), len, " ");
+        continue;
+      }
+
+      appendf(frame, sizeof(frame), len, "%s", sparklineLevels[bucket.level]);
+      min = std::min(min, bucket.min);
+      max = std::max(max, bucket.max);
+      sum += bucket.sum;
+      count += bucket.count;
+    }
+
+    if (count)
+      appendf(frame, sizeof(frame), len, " %.1f/%.1f/%.1f\n", max, min, sum / count);
+    else
+      appendf(frame, sizeof(frame), len, "\n");
+  }
+
+  void logEvent(const char *format, ...) {
+    char *event = events[eventCount++ % DASHBOARD_EVENTS];
+    time_t t = time(nullptr);
+    size_t len = strftime(event, EVENT_SIZE, "[%H:%M:%S] ", localtime(&t));
+    va_list args;
+
+    va_start(args, format);
+    vsnprintf(event + len, EVENT_SIZE - len, format, args);
+    va_end(args);
+  }
+
+  void logChanges(const zte_mf283plus_watch::InfoV2 &info) {
+    using namespace zte_mf283plus_watch;
+
+    const InfoV2 &previous = current;
+
+    if (!valid || info.NetworkType != previous.NetworkType)
+      logEvent("Network type: %s", getNetworkTypeInfo(NetworkTypeID(info.NetworkType)).Name);
+    if (valid && info.ProviderID != previous.ProviderID)
+      logEvent("Provider: %s (%d)", getProviderName(info.ProviderID), info.MCCMNC);
+    if (valid && info.Band != previous.Band && info.Band)
+      logEvent("Band: %d", info.Band);
+    if (valid && info.GlobalCellID != previous.GlobalCellID)
+      logEvent("Cell ID: %X -> %X", previous.GlobalCellID, info.GlobalCellID);
+    if (valid && info.LAC != previous.LAC && (info.Present & INFO_HAS_LAC))
+      logEvent("LAC: %d -> %d", previous.LAC, info.LAC);
+    if ((info.Present ^ previous.Present) & INFO_STALE)
+      logEvent((info.Present & INFO_STALE) ? "Showing cached values" : "Live values");
+  }
+
+  // No heartbeat for three intervals means the router stopped answering
+  void checkStall(int64_t now, const zte_mf283plus_watch::Heartbeat &heartbeat) {
+    int64_t limit = std::max<int64_t>(3LL * updateInterval, 3000) * 1000000LL;
+    bool isStalled = now - heartbeat.LastMono > limit;
+
+    if (isStalled != stalled) {
+      if (isStalled)
+        logEvent("No data since %.0fs", (now - heartbeat.LastMono) / 1e9);
+      else
+        logEvent("Data resumed");
+      stalled = isStalled;
+    }
+  }
+
+  static const size_t EVENT_SIZE = 128;
+
+  Bucket buckets[DASHBOARD_METRICS][SPARKLINE_COLUMNS];
+  char events[DASHBOARD_EVENTS][EVENT_SIZE];
+  size_t eventCount = 0;
+  char frame[8192];
+  zte_mf283plus_watch::InfoV2 current = zte_mf283plus_watch::InfoV2();
+  bool valid = false;
+  bool stalled = false;
+  uint64_t beats = 0;
+  int updateInterval;
+};
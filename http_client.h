@@ -0,0 +1,433 @@
+/*
+  This is free and unencumbered software released into the public domain.
+
+  Anyone is free to copy, modify, publish, use, compile, sell, or
+  distribute this software, either in source code form or as a compiled
+  binary, for any purpose, commercial or non-commercial, and by any
+  means.
+
+  In jurisdictions that recognize copyright laws, the author or authors
+  of this software dedicate any and all copyright interest in the
+  software to the public domain. We make this dedication for the benefit
+  of the public at large and to the detriment of our heirs and
+  successors. We intend this dedication to be an overt act of
+  relinquishment in perpetuity of all present and future rights to this
+  software under copyright law.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+  OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+  OTHER DEALINGS IN THE SOFTWARE.
+
+  For more information, please refer to <http://unlicense.org/>
+*/
+
+// Minimal HTTP/1.1 client, see TRANSPORT_BUILTIN.
+// Included into an unnamed namespace by zte_mf283plus_watch.cpp.
+// The connection to the router is kept alive and all buffers are reused,
+// so once warmed up a request does not allocate.
+
+class HTTPClient {
+public:
+  ~HTTPClient() { close(); }
+
+  // Any complete response counts as success, the same as with curl
+  bool request(const char *host, const char *path, const char *POSTData,
+               RequestKind kind, int timeoutMs, std::string &body,
+               Response &response, RequestTimes &times) {
+    auto start = std::chrono::steady_clock::now();
+    deadline = start + std::chrono::milliseconds(timeoutMs);
+    times = RequestTimes();
+
+    for (int attempt = 0; attempt < 2; ++attempt) {
+      bool reused = fd != -1;
+
+      if (!reused) {
+        if (cancelled() || !connect(host, start, times))
+          return false;
+      }
+
+      body.clear();
+      gotResponseData = false;
+
+      if (!cancelled() && sendRequest(host, path, POSTData, kind) &&
+          readResponse(body, kind == REQUEST_HEAD, response, start, times)) {
+        times.Total = elapsedUs(start);
+        return true;
+      }
+
+      close();
+
+      // A kept alive connection may have been closed by the router in
+      // the meantime, retry once with a fresh one
+      if (!reused || gotResponseData || cancelled())
+        break;
+    }
+
+    return false;
+  }
+
+  void close() {
+    if (fd != -1)
+      ::close(fd);
+
+    fd = -1;
+    bufStart = bufEnd = 0;
+  }
+
+  // Splits "host[:port]" and resolves it, free the result with freeaddrinfo()
+  static addrinfo *resolve(const char *host) {
+    char name[256];
+    const char *port = "80";
+    const char *colon = strrchr(host, ':');
+
+    snprintf(name, sizeof(name), "%s", host);
+
+    if (colon && colon == strchr(host, ':')) { // "host:port", not IPv6
+      name[colon - host] = '\0';
+      port = colon + 1;
+    }
+
+    addrinfo hints = {}, *addresses;
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    if (getaddrinfo(name, port, &hints, &addresses))
+      return nullptr;
+
+    return addresses;
+  }
+
+  // Connects without sending a request, the connection is kept for the
+  // next one
+  bool open(const addrinfo *addresses, int timeoutMs) {
+    close();
+    deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    return connect(addresses);
+  }
+
+  void setConnectTimeout(int timeoutMs) { connectTimeoutMs = timeoutMs; }
+
+  // A request fails within CANCEL_CHECK_MS once *flag is set
+  void setCancel(const std::atomic<bool> *flag) { cancel = flag; }
+
+private:
+  typedef std::chrono::steady_clock::time_point TimePoint;
+
+  static const int CANCEL_CHECK_MS = 100;
+
+  int remainingMs() const {
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                  deadline - std::chrono::steady_clock::now()).count();
+    return ms > 0 ? int(ms) : 0;
+  }
+
+  bool cancelled() const { return cancel && cancel->load(); }
+
+  // Waits until the deadline, checking the cancel flag if there is one
+  // every CANCEL_CHECK_MS
+  bool wait(short events) {
+    pollfd pfd = { fd, events, 0 };
+    int rc;
+
+    for (;;) {
+      if (cancelled())
+        return false;
+
+      int ms = remainingMs();
+      rc = poll(&pfd, 1, cancel && ms > CANCEL_CHECK_MS ? CANCEL_CHECK_MS : ms);
+
+      if (rc < 0 && errno == EINTR)
+        continue;
+
+      // Only a slice timed out, not the deadline
+      if (rc == 0 && cancel && remainingMs() > 0)
+        continue;
+
+      break;
+    }
+
+    return rc > 0 && !(pfd.revents & POLLNVAL);
+  }
+
+  bool connect(const char *host, TimePoint start, RequestTimes &times) {
+    addrinfo *addresses = resolve(host);
+
+    if (!addresses)
+      return false;
+
+    times.NameLookup = elapsedUs(start);
+
+    // The connect timeout only shortens the request timeout
+    TimePoint requestDeadline = deadline;
+    deadline = std::min(deadline, std::chrono::steady_clock::now() +
+                                      std::chrono::milliseconds(connectTimeoutMs));
+    connect(addresses);
+    deadline = requestDeadline;
+
+    freeaddrinfo(addresses);
+    times.Connect = elapsedUs(start);
+    return fd != -1;
+  }
+
+  bool connect(const addrinfo *addresses) {
+    for (const addrinfo *a = addresses; a && fd == -1; a = a->ai_next) {
+      fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+
+      if (fd == -1)
+        continue;
+
+      int one = 1;
+      fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+#ifdef SO_NOSIGPIPE
+      setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+
+      int error = 0;
+      socklen_t len = sizeof(error);
+
+      if (::connect(fd, a->ai_addr, a->ai_addrlen) == 0 ||
+          (errno == EINPROGRESS && wait(POLLOUT) &&
+           !getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &len) && !error))
+        break;
+
+      close();
+    }
+
+    return fd != -1;
+  }
+
+  bool sendAll(const char *data, size_t length) {
+#ifdef MSG_NOSIGNAL
+    const int flags = MSG_NOSIGNAL;
+#else
+    const int flags = 0;
+#endif
+
+    while (length) {
+      ssize_t n = send(fd, data, length, flags);
+
+      if (n > 0) {
+        data += n;
+        length -= n;
+      } else if (n < 0 && errno == EINTR) {
+        continue;
+      } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        if (!wait(POLLOUT))
+          return false;
+      } else {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  bool sendRequest(const char *host, const char *path, const char *POSTData,
+                   RequestKind kind) {
+    int len;
+
+    if (kind == REQUEST_HEAD)
+      len = snprintf(requestBuf, sizeof(requestBuf),
+                     "HEAD %s HTTP/1.1\r\nHost: %s\r\nReferer: http://%s/index.html\r\n"
+                     "Accept: */*\r\n\r\n",
+                     path, host, host);
+    else if (kind == REQUEST_TAIL)
+      len = snprintf(requestBuf, sizeof(requestBuf),
+                     "GET %s HTTP/1.1\r\nHost: %s\r\nReferer: http://%s/index.html\r\n"
+                     "Accept: */*\r\nRange: bytes=-%d\r\n\r\n",
+                     path, host, host, TAIL_BYTES);
+    else if (POSTData)
+      len = snprintf(requestBuf, sizeof(requestBuf),
+                     "POST %s HTTP/1.1\r\nHost: %s\r\nReferer: http://%s/index.html\r\n"
+                     "Accept: */*\r\nContent-Type: application/x-www-form-urlencoded\r\n"
+                     "Content-Length: %zu\r\n\r\n",
+                     path, host, host, strlen(POSTData));
+    else
+      len = snprintf(requestBuf, sizeof(requestBuf),
+                     "GET %s HTTP/1.1\r\nHost: %s\r\nReferer: http://%s/index.html\r\n"
+                     "Accept: */*\r\n\r\n",
+                     path, host, host);
+
+    if (len < 0 || size_t(len) >= sizeof(requestBuf))
+      return false;
+
+    return sendAll(requestBuf, len) && (!POSTData || sendAll(POSTData, strlen(POSTData)));
+  }
+
+  // Reads more data into buf, false on error, timeout or EOF. eof tells
+  // whether the peer closed the connection cleanly.
+  bool fill() {
+    eof = false;
+
+    if (bufStart == bufEnd) {
+      bufStart = bufEnd = 0;
+    } else if (bufEnd == sizeof(buf)) {
+      if (bufStart == 0)
+        return false; // line too long
+      memmove(buf, buf + bufStart, bufEnd - bufStart);
+      bufEnd -= bufStart;
+      bufStart = 0;
+    }
+
+    for (;;) {
+      ssize_t n = recv(fd, buf + bufEnd, sizeof(buf) - bufEnd, 0);
+
+      if (n > 0) {
+        bufEnd += n;
+        gotResponseData = true;
+#ifdef TCP_QUICKACK
+        // Servers that write the header and body separately would
+        // otherwise stall on our delayed ACK, it is reset by the kernel
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_QUICKACK, &one, sizeof(one));
+#endif
+        return true;
+      }
+
+      if (n == 0) {
+        eof = true;
+        return false;
+      }
+
+      if (n < 0 && errno == EINTR)
+        continue;
+
+      if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) && wait(POLLIN))
+        continue;
+
+      return false;
+    }
+  }
+
+  // Returns the next line without its line break
+  bool readLine(const char *&line, size_t &length) {
+    for (;;) {
+      char *begin = buf + bufStart;
+      char *p = (char *)memchr(begin, '\n', bufEnd - bufStart);
+
+      if (p) {
+        line = begin;
+        length = p - begin;
+        if (length && p[-1] == '\r')
+          --length;
+        bufStart = p + 1 - buf;
+        return true;
+      }
+
+      if (!fill())
+        return false;
+    }
+  }
+
+  bool readBody(size_t length, std::string &body) {
+    while (length) {
+      if (bufStart == bufEnd && !fill())
+        return false;
+
+      size_t n = std::min(length, bufEnd - bufStart);
+      body.append(buf + bufStart, n);
+      bufStart += n;
+      length -= n;
+    }
+
+    return true;
+  }
+
+  static bool startsWith(const char *line, size_t length, const char *prefix) {
+    size_t n = strlen(prefix);
+    return length >= n && !strncasecmp(line, prefix, n);
+  }
+
+  bool readResponse(std::string &body, bool head, Response &response,
+                    TimePoint start, RequestTimes &times) {
+    const char *line;
+    size_t length;
+
+    if (bufStart == bufEnd && !fill())
+      return false;
+
+    times.StartTransfer = elapsedUs(start);
+
+    if (!readLine(line, length) || !startsWith(line, length, "HTTP/1."))
+      return false;
+
+    parseResponseHeader(line, length, response);
+
+    bool keepAlive = line[7] != '0';
+    bool chunked = false;
+    long long contentLength = -1;
+
+    while (readLine(line, length) && length) {
+      parseResponseHeader(line, length, response);
+
+      if (startsWith(line, length, "Content-Length:"))
+        contentLength = atoll(line + strlen("Content-Length:"));
+      else if (startsWith(line, length, "Transfer-Encoding:"))
+        chunked = memmem(line, length, "chunked", strlen("chunked")) != nullptr;
+      else if (startsWith(line, length, "Connection:"))
+        keepAlive = memmem(line, length, "lose", strlen("lose")) == nullptr;
+    }
+
+    if (length) // header was truncated
+      return false;
+
+    if (head) {
+      // No body, whatever the header says
+    } else if (chunked) {
+      for (;;) {
+        if (!readLine(line, length))
+          return false;
+
+        size_t chunkLength = strtoul(line, nullptr, 16);
+
+        if (!chunkLength)
+          break;
+
+        if (!readBody(chunkLength, body) || !readLine(line, length))
+          return false;
+      }
+
+      while (readLine(line, length) && length) // trailer
+        ;
+
+      if (length)
+        return false;
+    } else if (contentLength >= 0) {
+      if (!readBody(size_t(contentLength), body))
+        return false;
+    } else {
+      // Delimited by the end of the connection, a timeout or reset leaves
+      // it truncated
+      while (bufStart != bufEnd || fill()) {
+        body.append(buf + bufStart, bufEnd - bufStart);
+        bufStart = bufEnd;
+      }
+
+      if (!eof)
+        return false;
+
+      keepAlive = false;
+    }
+
+    if (!keepAlive)
+      close();
+
+    return true;
+  }
+
+  int fd = -1;
+  TimePoint deadline;
+  int connectTimeoutMs = 30000;
+  const std::atomic<bool> *cancel = nullptr;
+  bool gotResponseData;
+  bool eof = false;
+  char requestBuf[1024];
+  char buf[16384];
+  size_t bufStart = 0;
+  size_t bufEnd = 0;
+};
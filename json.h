@@ -0,0 +1,144 @@
+/*
+  This is free and unencumbered software released into the public domain.
+
+  Anyone is free to copy, modify, publish, use, compile, sell, or
+  distribute this software, either in source code form or as a compiled
+  binary, for any purpose, commercial or non-commercial, and by any
+  means.
+
+  In jurisdictions that recognize copyright laws, the author or authors
+  of this software dedicate any and all copyright interest in the
+  software to the public domain. We make this dedication for the benefit
+  of the public at large and to the detriment of our heirs and
+  successors. We intend this dedication to be an overt act of
+  relinquishment in perpetuity of all present and future rights to this
+  software under copyright law.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+  OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+  OTHER DEALINGS IN THE SOFTWARE.
+
+  For more information, please refer to <http://unlicense.org/>
+*/
+
+// Minimal JSON scanner for the flat objects returned by the router's
+// goform_get_cmd_process endpoint.
+// Included into an unnamed namespace by zte_mf283plus_watch.cpp.
+// Tokens point into the scanned buffer, nothing is allocated or decoded.
+
+struct JSONToken {
+  const char *Data;
+  size_t Length;
+
+  bool equals(const char *s) const {
+    return !strncmp(Data, s, Length) && s[Length] == '\0';
+  }
+
+  // Copies the raw token, escape sequences are left as they are
+  template <size_t N>
+  void copyTo(char (&buf)[N]) const {
+    size_t len = std::min(Length, N - 1);
+    memcpy(buf, Data, len);
+    buf[len] = '\0';
+  }
+};
+
+class JSONScanner {
+public:
+  JSONScanner(const char *data, size_t length) : p(data), end(data + length) {}
+
+  // Enters the top level object
+  bool begin() {
+    skipSpace();
+    return p < end && *p++ == '{';
+  }
+
+  // Returns the next member of the current object. String values are
+  // returned without their quotes, nested objects and arrays verbatim.
+  bool next(JSONToken &key, JSONToken &value) {
+    skipSpace();
+
+    if (p < end && *p == ',')
+      ++p, skipSpace();
+
+    if (p >= end || *p != '"' || !scanString(key))
+      return false;
+
+    skipSpace();
+
+    if (p >= end || *p++ != ':')
+      return false;
+
+    skipSpace();
+
+    if (p >= end)
+      return false;
+
+    if (*p == '"')
+      return scanString(value);
+
+    const char *start = p;
+    int depth = 0;
+
+    for (; p < end; ++p) {
+      char c = *p;
+
+      if (c == '"') {
+        JSONToken tmp;
+        if (!scanString(tmp))
+          return false;
+        --p;
+      } else if (c == '{' || c == '[') {
+        ++depth;
+      } else if (c == '}' || c == ']') {
+        if (depth-- == 0)
+          break;
+      } else if (c == ',' && depth == 0) {
+        break;
+      }
+    }
+
+    if (depth > 0)
+      return false;
+
+    value.Data = start;
+    value.Length = p - start;
+
+    while (value.Length && isSpace(value.Data[value.Length - 1]))
+      --value.Length;
+
+    return true;
+  }
+
+private:
+  static bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+  }
+
+  void skipSpace() {
+    while (p < end && isSpace(*p))
+      ++p;
+  }
+
+  bool scanString(JSONToken &token) {
+    token.Data = ++p;
+
+    for (; p < end; ++p) {
+      if (*p == '\\') {
+        ++p;
+      } else if (*p == '"') {
+        token.Length = p++ - token.Data;
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  const char *p;
+  const char *end;
+};
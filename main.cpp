@@ -35,6 +35,12 @@
 #include <csignal>
 #include <cassert>
 #include <ctime>
+#include <limits>
+#include <chrono>
+#include <cstdarg>
+#include <cmath>
+#include <string>
+#include <vector>
 
 #include "zte_mf283plus_watch.h"
 
@@ -46,19 +52,15 @@
 #define LINES 20
 #else
 #include <unistd.h>
-#include <netdb.h>
+#include <poll.h>
 #include <sys/types.h>
-#include <sys/socket.h>
-#include <netinet/in.h>
-#include <arpa/inet.h>
-#define Sleep(ms) usleep(ms * 1000)
+#include <sys/ioctl.h>
+#define Sleep(ms) usleep((ms) * 1000)
 #endif
 
 // safe strncpy - http://stackoverflow.com/q/869883
 #define strncpy(dst, src, len) snprintf(dst, len, "%s", src)
 
-//#define EXPERIMENTAL
-
 namespace {
 
 std::atomic_bool shouldExit;
@@ -120,6 +122,8 @@ void clearScreen(bool force = false) {
 #endif
 }
 
+#include "renderer.h"
+
 void error(const char *msg) {
   fprintf(stderr, "Error: %s%s\n", msg, (msg[0] && msg[strlen(msg) - 1] != '?' ? "!" : ""));
 #ifdef _WIN32
@@ -129,26 +133,27 @@ void error(const char *msg) {
 }
 
 void getRouterIP(char *routerIP, size_t size) {
-#ifdef EXPERIMENTAL
   printf("Getting Router IP...\n");
-  struct hostent *h = gethostbyname("ralink.ralinktech.com");
+  bool found = zte_mf283plus_watch::discoverRouter(routerIP, size);
+  clearScreen(true);
 
-  if (h)
-    strncpy(routerIP, inet_ntoa(*((struct in_addr *)h->h_addr)), size);
+  if (found)
+    return;
 
-  clearScreen(true);
-#else
-  void *h = nullptr;
+#ifndef _WIN32
+  // Nobody to ask when running headless
+  if (!isatty(STDIN_FILENO)) {
+    strncpy(routerIP, "192.168.0.1", size);
+    return;
+  }
 #endif
 
-  if (!h || !strcmp(routerIP, "127.0.0.1")) {
-    printf("Router IP [192.168.0.1]: ");
+  printf("Router IP [192.168.0.1]: ");
 
-    if (fgets(routerIP, size, stdin) && routerIP[0] != '\n') {
-      routerIP[strlen(routerIP) - 1] = '\0';
-    } else {
-      strncpy(routerIP, "192.168.0.1", size);
-    }
+  if (fgets(routerIP, size, stdin) && routerIP[0] != '\n') {
+    routerIP[strlen(routerIP) - 1] = '\0';
+  } else {
+    strncpy(routerIP, "192.168.0.1", size);
   }
 }
 
@@ -173,6 +178,376 @@ void getRouterPassword(char *routerPass, size_t size) {
   }
 }
 
+void formatLatencyStats(char *str, size_t size) {
+  zte_mf283plus_watch::Stats stats;
+  size_t len = 0;
+  bool first = true;
+
+  str[0] = '\0';
+
+  if (!zte_mf283plus_watch::getStats(stats))
+    return;
+
+  len += snprintf(str, size, "[Latency ms (p50/p99/max):");
+
+  for (int i = 0; i < zte_mf283plus_watch::PHASE_COUNT && len < size; ++i) {
+    const zte_mf283plus_watch::PhaseStats &phase = stats.Phase[i];
+
+    if (!phase.Count)
+      continue;
+
+    len += snprintf(str + len, size - len, "%s %s %.1f/%.1f/%.1f",
+                    first ? "" : ",",
+                    zte_mf283plus_watch::getPhaseName(zte_mf283plus_watch::StatsPhase(i)),
+                    phase.P50Us / 1000.0, phase.P99Us / 1000.0, phase.MaxUs / 1000.0);
+    first = false;
+  }
+
+  if (len < size)
+    len += snprintf(str + len, size - len, "]");
+
+  if (stats.SkippedPolls && len < size)
+    len += snprintf(str + len, size - len, " [Unchanged polls: %llu]",
+                    (unsigned long long)stats.SkippedPolls);
+
+  if (stats.FirstSampleUs && len < size)
+    snprintf(str + len, size - len, " [First sample: %.1f ms]", stats.FirstSampleUs / 1000.0);
+}
+
+// Time since the router last confirmed the values, which only get
+// republished when they change
+
+double getAge(const zte_mf283plus_watch::Info &info, bool testMode) {
+  zte_mf283plus_watch::Heartbeat heartbeat;
+
+  if (!testMode && zte_mf283plus_watch::getHeartbeat(heartbeat))
+    return (zte_mf283plus_watch::getMonotonicTime() - heartbeat.LastMono) / 1e9;
+
+  return double(time(nullptr) - info.LastUpdate);
+}
+
+// Whether there was a heartbeat since the last call. The --stats min/max/avg
+// count every poll, a value held for a minute weighs more than a blip.
+
+bool newHeartbeat(uint64_t &beats) {
+  zte_mf283plus_watch::Heartbeat heartbeat;
+
+  if (!zte_mf283plus_watch::getHeartbeat(heartbeat) || heartbeat.Count == beats)
+    return false;
+
+  beats = heartbeat.Count;
+  return true;
+}
+
+// Whether the published measurements were restored from the per-RAT cache
+// after a network switch, age is how old they are
+
+bool getStaleAge(bool testMode, double &age) {
+  zte_mf283plus_watch::InfoV2 v2;
+
+  if (testMode || !zte_mf283plus_watch::getInfoV2(v2) || !(v2.Present & zte_mf283plus_watch::INFO_STALE))
+    return false;
+
+  age = v2.RouterTime ? (v2.PublishWall - v2.RouterTime) / 1e9 : 0.0;
+  return true;
+}
+
+void appendf(char *str, size_t size, size_t &len, const char *format, ...) {
+  va_list args;
+
+  if (len >= size)
+    return;
+
+  va_start(args, format);
+  len += vsnprintf(str + len, size - len, format, args);
+  va_end(args);
+}
+
+// --delta: prints the fields changed since the last call
+void printDelta(uint64_t &version) {
+  using namespace zte_mf283plus_watch;
+
+  InfoV2 v2;
+  uint32_t changes = getChanges(version, v2) &
+                     ~(CHANGE_PRESENT | CHANGE_LAST_UPDATE | CHANGE_ROUTER_TIME);
+  char str[512];
+  size_t len = 0;
+
+  if (!changes)
+    return;
+
+  time_t t = time(nullptr);
+  len = strftime(str, sizeof(str), "[%Y-%m-%d - %H:%M:%S] |", localtime(&t));
+
+  if (changes & CHANGE_NETWORK_TYPE)
+    appendf(str, sizeof(str), len, " NetworkType=%s",
+            getNetworkTypeInfo(NetworkTypeID(v2.NetworkType)).Name);
+  if (changes & CHANGE_PROVIDER)
+    appendf(str, sizeof(str), len, " Provider=\"%s\" MCCMNC=%d",
+            getProviderName(v2.ProviderID), v2.MCCMNC);
+  const struct {
+    uint32_t change;
+    const char *name;
+    int16_t value;
+  } signals[] = {
+    { CHANGE_RSRP, "RSRP", v2.RSRP }, { CHANGE_RSCP, "RSCP", v2.RSCP },
+    { CHANGE_RSRQ, "RSRQ", v2.RSRQ }, { CHANGE_RSSI, "RSSI", v2.RSSI }
+  };
+
+  for (const auto &signal : signals) {
+    if (!(changes & signal.change))
+      continue;
+    if (signal.value == INFO_V2_NOT_AVAILABLE)
+      appendf(str, sizeof(str), len, " %s=n/a", signal.name);
+    else
+      appendf(str, sizeof(str), len, " %s=%d", signal.name, signal.value);
+  }
+
+  const struct {
+    uint32_t change;
+    const char *name;
+    float value;
+  } ratios[] = {
+    { CHANGE_SINR, "SINR", v2.SINR }, { CHANGE_ECIO, "ECIO", v2.ECIO }, { CHANGE_CSQ, "CSQ", v2.CSQ }
+  };
+
+  for (const auto &ratio : ratios) {
+    if (!(changes & ratio.change))
+      continue;
+    if (std::isnan(ratio.value))
+      appendf(str, sizeof(str), len, " %s=n/a", ratio.name);
+    else
+      appendf(str, sizeof(str), len, " %s=%.1f", ratio.name, ratio.value);
+  }
+
+  if (changes & CHANGE_LAC)
+    appendf(str, sizeof(str), len, " LAC=%d", v2.LAC);
+  if (changes & CHANGE_CELL_ID)
+    appendf(str, sizeof(str), len, " CellID=%X", v2.GlobalCellID);
+  if (changes & CHANGE_FREQUENCY)
+    appendf(str, sizeof(str), len, " Frequency=%d", v2.Frequency);
+  if (changes & CHANGE_CHANNEL)
+    appendf(str, sizeof(str), len, " Channel=%d", v2.Channel);
+  if (changes & CHANGE_BAND)
+    appendf(str, sizeof(str), len, " Band=%d", v2.Band);
+
+  printf("%s\n", str);
+  fflush(stdout);
+}
+
+void printSamples(uint64_t &sequence) {
+  zte_mf283plus_watch::Sample samples[64];
+  size_t count;
+
+  while ((count = zte_mf283plus_watch::getSamples(&sequence, samples, 64)) > 0) {
+    for (size_t i = 0; i < count; ++i) {
+      const zte_mf283plus_watch::Sample &s = samples[i];
+      const zte_mf283plus_watch::NetworkTypeInfo &networkType =
+          zte_mf283plus_watch::getNetworkTypeInfo(zte_mf283plus_watch::NetworkTypeID(s.NetworkType));
+      time_t t = time_t(s.RouterTime / 1000000000);
+      char timeStr[64];
+
+      strftime(timeStr, sizeof(timeStr), "[%Y-%m-%d - %H:%M:%S]", localtime(&t));
+
+      if (s.Kind == zte_mf283plus_watch::SAMPLE_CSQ)
+        printf("%s | [%s] [CSQ: %.1f]\n", timeStr, networkType.Name, s.CSQ);
+      else if (networkType.Generation == 4)
+        printf("%s | [%s] [RSRP: %d, RSRQ: %d, RSSI: %d, SINR: %.1f]\n",
+               timeStr, networkType.Name, s.RSRP, s.RSRQ, s.RSSI, s.SINR);
+      else if (networkType.Generation == 3)
+        printf("%s | [%s] [RSCP: %d, EC/IO: %.1f]\n", timeStr, networkType.Name, s.RSCP, s.ECIO);
+      else
+        printf("%s | [%s] [RSSI: %d]\n", timeStr, networkType.Name, s.RSSI);
+    }
+  }
+}
+
+// --align: large bars of the two main signal values for antenna alignment,
+// smoothed over a short window against jitter, with peak hold per
+// generation so switching back and forth keeps the peaks. Every heartbeat
+// adds a sample, a value that stays unchanged is not republished but
+// still fills the window.
+
+const int MIN_UPDATE_INTERVAL = 100;
+const int64_t ALIGN_WINDOW_NS = 600 * 1000000LL;
+const int ALIGN_BAR_WIDTH = 60;
+
+struct AlignMeter {
+  const char *name;
+  const char *unit;
+  float low, high; // scale of the bar
+};
+
+// Indexed by generation (0, 2, 3, 4)
+const AlignMeter alignMeters[5][2] = {
+  {}, {},
+  { { "RSSI", "dBm", -110.f, -50.f }, { "CSQ", "", 0.f, 31.f } },
+  { { "RSCP", "dBm", -120.f, -25.f }, { "EC/IO", "dB", -24.f, 0.f } },
+  { { "RSRP", "dBm", -140.f, -44.f }, { "SINR", "dB", -10.f, 30.f } }
+};
+
+struct AlignState {
+  struct {
+    int64_t mono;
+    float value;
+  } window[2][16];
+  size_t windowSize[2] = {};
+  float peak[5][2];
+  int generation = -1;
+  uint64_t beats = 0;
+  size_t N = size_t(-1);
+  float lastLatency = NAN;
+  MinMaxSum<float> latency;
+
+  AlignState() {
+    for (float (&generationPeak)[2] : peak)
+      generationPeak[0] = generationPeak[1] = -INFINITY;
+  }
+
+  void add(int meter, int64_t mono, float value) {
+    size_t &size = windowSize[meter];
+    size_t kept = 0;
+
+    for (size_t i = 0; i < size; ++i) {
+      if (mono - window[meter][i].mono < ALIGN_WINDOW_NS && kept < 15)
+        window[meter][kept++] = window[meter][i];
+    }
+
+    window[meter][kept] = { mono, value };
+    size = kept + 1;
+  }
+
+  // Average over the ALIGN_WINDOW_NS before now, the last sample if there
+  // was no heartbeat since
+  float average(int meter, int64_t now) const {
+    size_t size = windowSize[meter];
+    size_t count = 0;
+    double sum = 0;
+
+    for (size_t i = 0; i < size; ++i) {
+      if (now - window[meter][i].mono < ALIGN_WINDOW_NS) {
+        sum += window[meter][i].value;
+        ++count;
+      }
+    }
+
+    return count ? float(sum / count) : window[meter][size - 1].value;
+  }
+};
+
+void formatBar(char *str, float value, float peak, const AlignMeter &meter) {
+  auto position = [&](float v) {
+    int pos = int(lroundf((v - meter.low) / (meter.high - meter.low) * ALIGN_BAR_WIDTH));
+    return std::min(std::max(pos, 0), ALIGN_BAR_WIDTH);
+  };
+
+  int fill = position(value);
+  int peakPos = std::isinf(peak) ? -1 : std::min(position(peak), ALIGN_BAR_WIDTH - 1);
+
+  for (int i = 0; i < ALIGN_BAR_WIDTH; ++i)
+    str[i] = i == peakPos ? '|' : i < fill ? '#' : '.';
+
+  str[ALIGN_BAR_WIDTH] = '\0';
+}
+
+void renderAlign(AlignState &state, zte_mf283plus_watch::Info &info, bool testMode,
+                 Renderer &renderer) {
+  using namespace zte_mf283plus_watch;
+
+  InfoV2 v2;
+  int64_t now = getMonotonicTime();
+  int64_t beatMono = now;
+  bool beat = true;
+
+  if (testMode) {
+    fakeGetInfo(info);
+    convertInfo(info, v2);
+  } else {
+    Heartbeat heartbeat;
+
+    if (!getHeartbeat(heartbeat) || !getInfoV2(v2))
+      return;
+
+    beat = heartbeat.Count != state.beats;
+    state.beats = heartbeat.Count;
+    beatMono = heartbeat.LastMono;
+  }
+
+  // Redrawn on every call, so that the window ages out between heartbeats
+  const NetworkTypeInfo &networkType = getNetworkTypeInfo(NetworkTypeID(v2.NetworkType));
+  int generation = networkType.Generation;
+  char str[2048];
+  size_t len = 0;
+
+  // Values of different RATs do not mix
+  if (generation != state.generation) {
+    state.windowSize[0] = state.windowSize[1] = 0;
+    state.generation = generation;
+  }
+
+  if (!generation) {
+    appendf(str, sizeof(str), len, "No Service!\n");
+  } else {
+    appendf(str, sizeof(str), len, "[%s | %s", networkType.Name, getProviderName(v2.ProviderID));
+    if (v2.Band)
+      appendf(str, sizeof(str), len, " | Band %d", v2.Band);
+    appendf(str, sizeof(str), len, "] [CELL ID: %X]%s\n\n", v2.GlobalCellID,
+            (v2.Present & INFO_STALE) ? " [Cached]" : "");
+
+    float values[2];
+
+    switch (generation) {
+      case 4: values[0] = v2.RSRP; values[1] = v2.SINR; break;
+      case 3: values[0] = v2.RSCP; values[1] = v2.ECIO; break;
+      default: values[0] = v2.RSSI; values[1] = v2.CSQ; break;
+    }
+
+    for (int i = 0; i < 2; ++i) {
+      const AlignMeter &meter = alignMeters[generation][i];
+      float &peak = state.peak[generation][i];
+      char bar[ALIGN_BAR_WIDTH + 1];
+
+      if (i == 0 && values[i] == INFO_V2_NOT_AVAILABLE)
+        values[i] = NAN;
+
+      if (std::isnan(values[i]) || (v2.Present & INFO_STALE)) {
+        appendf(str, sizeof(str), len, "%-6s %8s\n\n", meter.name, "n/a");
+        continue;
+      }
+
+      if (beat || !state.windowSize[i])
+        state.add(i, beatMono, values[i]);
+
+      float average = state.average(i, now);
+      peak = std::max(peak, average);
+      formatBar(bar, average, peak, meter);
+      appendf(str, sizeof(str), len, "%-6s %6.1f %-3s [%s] Peak: %.1f\n\n",
+              meter.name, average, meter.unit, bar, peak);
+    }
+  }
+
+  // From the start of the fetch to the screen, for new snapshots only
+  if (v2.FetchStartMono && v2.N != state.N) {
+    state.lastLatency = (now - v2.FetchStartMono) / 1e6f;
+    state.latency.update(state.lastLatency);
+  }
+
+  state.N = v2.N;
+
+  if (!std::isnan(state.lastLatency))
+    appendf(str, sizeof(str), len, "[Display latency ms: %.1f (avg %.1f, max %.1f)]\n",
+            state.lastLatency, state.latency.avg(), state.latency.max);
+
+  if (noClearScreen) {
+    printf("%s\n", str);
+    fflush(stdout);
+  } else {
+    renderer.render(str);
+  }
+}
+
+#include "dashboard.h"
+
 void signalHandler(int) {
   shouldExit = true;
 }
@@ -181,11 +556,6 @@ void signalHandler(int) {
 
 int main(int argc, char **argv) {
 #ifdef _WIN32
-#ifdef EXPERIMENTAL
-  WSADATA wsaData;
-  if (WSAStartup(0x0202, &wsaData))
-    error("Initing Winsock failed");
-#endif
   system("mode con:cols=" xstr(COLS) " lines=" xstr(LINES));
 #endif
 
@@ -194,10 +564,21 @@ int main(int argc, char **argv) {
 
   char routerIP[64] = "";
   char routerPW[33] = "";
-  int updateInterval = 1000;
+  int updateInterval = -1;
   bool pipe = false;
   bool testMode = false;
   bool showStats = false;
+  bool backfill = false;
+  bool conditionalFetch = false;
+  bool delta = false;
+  bool align = false;
+  bool dashboard = false;
+  const char *recordDir = nullptr;
+  const char *replayFile = nullptr;
+  double replaySpeed = 1.0;
+  int dataSource = -1;
+  int transport = -1;
+  int parseThreads = 0;
 
   for (int i = 1; i < argc; ++i) {
     const char *parameter = argv[i];
@@ -213,6 +594,22 @@ int main(int argc, char **argv) {
     } else if (!strcmp(parameter, "--stats")) {
       showStats = true;
       continue;
+    } else if (!strcmp(parameter, "--backfill")) {
+      backfill = true;
+      continue;
+    } else if (!strcmp(parameter, "--conditional-fetch")) {
+      conditionalFetch = true;
+      continue;
+    } else if (!strcmp(parameter, "--delta")) {
+      delta = pipe = true;
+      noClearScreen = true;
+      continue;
+    } else if (!strcmp(parameter, "--align")) {
+      align = true;
+      continue;
+    } else if (!strcmp(parameter, "--dashboard")) {
+      dashboard = true;
+      continue;
     }
 
     value = argv[++i];
@@ -228,55 +625,129 @@ int main(int argc, char **argv) {
       strncpy(routerPW, value, sizeof(routerPW));
     else if (!strcmp(parameter, "--update-interval"))
       updateInterval = atoi(value);
+    else if (!strcmp(parameter, "--record"))
+      recordDir = value;
+    else if (!strcmp(parameter, "--replay"))
+      replayFile = value;
+    else if (!strcmp(parameter, "--speed"))
+      replaySpeed = strcmp(value, "max") ? atof(value) : 0.0;
+    else if (!strcmp(parameter, "--source"))
+      dataSource = strcmp(value, "status") ? zte_mf283plus_watch::DATA_SOURCE_SYSLOG
+                                           : zte_mf283plus_watch::DATA_SOURCE_STATUS;
+    else if (!strcmp(parameter, "--parse-threads"))
+      parseThreads = atoi(value);
+    else if (!strcmp(parameter, "--transport"))
+      transport = strcmp(value, "builtin") ? zte_mf283plus_watch::TRANSPORT_CURL
+                                           : zte_mf283plus_watch::TRANSPORT_BUILTIN;
+  }
+
+  // --align polls the small JSON status API as fast as allowed, over the
+  // builtin transport if available, unless told otherwise
+  if (updateInterval == -1)
+    updateInterval = align ? MIN_UPDATE_INTERVAL : 1000;
+
+  if (dataSource == -1)
+    dataSource = align ? zte_mf283plus_watch::DATA_SOURCE_STATUS : zte_mf283plus_watch::DATA_SOURCE_SYSLOG;
+
+  if (align && transport == -1)
+    zte_mf283plus_watch::setOption(zte_mf283plus_watch::OPT_TRANSPORT,
+                                   zte_mf283plus_watch::TRANSPORT_BUILTIN);
+
+  if (updateInterval < MIN_UPDATE_INTERVAL) {
+    fprintf(stderr, "--update-interval must be >= %d!\n", MIN_UPDATE_INTERVAL);
+    return 2;
   }
 
-  if (updateInterval < 100) {
-    fprintf(stderr, "--update-interval must be >= 100!\n");
+  zte_mf283plus_watch::setOption(zte_mf283plus_watch::OPT_BACKFILL, backfill && pipe);
+  zte_mf283plus_watch::setOption(zte_mf283plus_watch::OPT_DATA_SOURCE, dataSource);
+  zte_mf283plus_watch::setOption(zte_mf283plus_watch::OPT_CONDITIONAL_FETCH, conditionalFetch);
+  zte_mf283plus_watch::setOption(zte_mf283plus_watch::OPT_FIRST_SNAPSHOT, 1);
+
+  // Only the forward parse is split, the reverse one usually stops early
+  if (parseThreads > 1) {
+    if (!zte_mf283plus_watch::setOption(zte_mf283plus_watch::OPT_PARSE_THREADS, parseThreads)) {
+      fprintf(stderr, "--parse-threads must be <= 64!\n");
+      return 2;
+    }
+
+    zte_mf283plus_watch::setOption(zte_mf283plus_watch::OPT_PARSE_MODE,
+                                   zte_mf283plus_watch::PARSE_FORWARD);
+  }
+
+  if (transport != -1 && !zte_mf283plus_watch::setOption(zte_mf283plus_watch::OPT_TRANSPORT, transport)) {
+    fprintf(stderr, "--transport %s is not available in this build!\n",
+            transport == zte_mf283plus_watch::TRANSPORT_CURL ? "curl" : "builtin");
     return 2;
   }
 
-  if (!routerIP[0])
-    getRouterIP(routerIP, sizeof(routerIP));
-
-  getpass:;
-
-  if (!routerPW[0])
-    getRouterPassword(routerPW, sizeof(routerPW));
-
-  if (shouldExit)
-    return 0;
-
-  if (!testMode) {
-    switch (zte_mf283plus_watch::init(routerIP, routerPW, updateInterval)) {
-      case zte_mf283plus_watch::INIT_OK:
-        break;
-      case zte_mf283plus_watch::INIT_ERR_HTTP_REQUEST_FAILED:
-        error("HTTP Request failed");
-      case zte_mf283plus_watch::INIT_ERR_NOT_A_ZTE_MF283P:
-        error("Probably not a ZTE 283MF+ / 3Webgate 3");
-      case zte_mf283plus_watch::INIT_ERR_WRONG_PASSWORD:
-        fprintf(stderr, "Wrong Password!\n");
-        routerPW[0] = '\0';
-        goto getpass;
+  if (recordDir && !zte_mf283plus_watch::startRecording(recordDir))
+    error("Creating the record file failed");
+
+  if (replayFile) {
+    if (zte_mf283plus_watch::initReplay(replayFile, replaySpeed) != zte_mf283plus_watch::INIT_OK)
+      error("Opening the replay file failed");
+  } else {
+    if (!routerIP[0])
+      getRouterIP(routerIP, sizeof(routerIP));
+
+    getpass:;
+
+    if (!routerPW[0])
+      getRouterPassword(routerPW, sizeof(routerPW));
+
+    if (shouldExit)
+      return 0;
+
+    if (!testMode) {
+      auto pending = zte_mf283plus_watch::initAsync(routerIP, routerPW, updateInterval);
+      int state = -1;
+
+      while (pending.wait_for(std::chrono::milliseconds(20)) != std::future_status::ready) {
+        if (!pipe && state != zte_mf283plus_watch::getInitState()) {
+          state = zte_mf283plus_watch::getInitState();
+          clearScreen(true);
+          printf("%s...", zte_mf283plus_watch::getInitStateName(zte_mf283plus_watch::InitState(state)));
+          fflush(stdout);
+        }
+      }
+
+      if (state != -1)
+        printf("\n");
+
+      switch (pending.get()) {
+        case zte_mf283plus_watch::INIT_OK:
+          break;
+        case zte_mf283plus_watch::INIT_ERR_HTTP_REQUEST_FAILED:
+          error("HTTP Request failed");
+        case zte_mf283plus_watch::INIT_ERR_NOT_A_ZTE_MF283P:
+          error("Probably not a ZTE 283MF+ / 3Webgate 3");
+        case zte_mf283plus_watch::INIT_ERR_WRONG_PASSWORD:
+          fprintf(stderr, "Wrong Password!\n");
+          routerPW[0] = '\0';
+          goto getpass;
+        case zte_mf283plus_watch::INIT_ERR_OPEN_FAILED:
+          break;
+      }
     }
   }
 
+  zte_mf283plus_watch::Info info;
+
   clearScreen(true);
-  if (!pipe)
+  if (!pipe && !(testMode ? zte_mf283plus_watch::fakeGetInfo(info) : zte_mf283plus_watch::getInfo(info)))
     printf("Please be patient...");
   fflush(stdout);
-
-  zte_mf283plus_watch::Info info;
-  size_t N = size_t(-1);
-  const char *fmtStr = "%s%s [%ds]";
+  const char *fmtStr = "%s%s [%.1fs]";
   char str[1024] = "";
   char statsStr[1024] = "";
+  char latencyStr[512] = "";
   bool forceClearScreen = true;
 
   if (showStats)
-    fmtStr = pipe ? "%s%s [%ds] | %s" : (noClearScreen ? "%s%s [%ds]\n%s\n" : "%s%s [%ds]\n\n%s\n");
+    fmtStr = pipe ? "%s%s [%.1fs] | %s" : (noClearScreen ? "%s%s [%.1fs]\n%s\n" : "%s%s [%.1fs]\n\n%s\n");
 
-  struct {
+  // Kept per generation (0, 2, 3, 4) so stats resume after a switch back
+  struct RATStats {
     MinMaxSum<decltype(zte_mf283plus_watch::Info::RSRP)> RSRP;
     MinMaxSum<decltype(zte_mf283plus_watch::Info::RSCP)> RSCP;
     MinMaxSum<decltype(zte_mf283plus_watch::Info::RSRQ)> RSRQ;
@@ -285,28 +756,43 @@ int main(int argc, char **argv) {
     MinMaxSum<decltype(zte_mf283plus_watch::Info::ECIO)> ECIO;
     MinMaxSum<decltype(zte_mf283plus_watch::Info::CSQ)>  CSQ;
 
-    int NetworkType = -1;
-
-    void update(const zte_mf283plus_watch::Info &info, const int currentNetworkType) {
-      if (NetworkType != currentNetworkType) {
-        RSRP.reset(); RSCP.reset(); RSRQ.reset();
-        RSSI.reset(); SINR.reset(); ECIO.reset();
-        CSQ.reset();
-        NetworkType = currentNetworkType;
-      }
-
+    void update(const zte_mf283plus_watch::Info &info) {
       RSRP.update(info.RSRP); RSCP.update(info.RSCP); RSRQ.update(info.RSRQ);
       RSSI.update(info.RSSI); SINR.update(info.SINR); ECIO.update(info.ECIO);
       CSQ.update(info.CSQ);
     }
-  } stats;
+  } ratStats[5];
+
+  auto startTime = std::chrono::steady_clock::now();
+  uint64_t sampleSequence = 0;
+  uint64_t deltaVersion = 0;
+  uint64_t beats = 0;
+  AlignState alignState;
+  Renderer renderer;
+  Dashboard dashboardView(updateInterval);
+#ifndef _WIN32
+  int eventFD = testMode ? -1 : zte_mf283plus_watch::getEventFD();
+#endif
 
   do {
-    if ((testMode ? zte_mf283plus_watch::fakeGetInfo(info) : zte_mf283plus_watch::getInfo(info)) &&
-        info.N != N && info.GotNetworkType && info.GotSignalStrength && info.GotCSQ) {
-          
+    bool replayFinished = replayFile && zte_mf283plus_watch::isReplayFinished();
+
+    if (dashboard) {
+      dashboardView.update(info, testMode);
+      dashboardView.render(renderer, getAge(info, testMode));
+    } else if (align) {
+      renderAlign(alignState, info, testMode, renderer);
+    } else if ((testMode ? zte_mf283plus_watch::fakeGetInfo(info) : zte_mf283plus_watch::getInfo(info)) &&
+               (testMode || newHeartbeat(beats)) &&
+               info.GotNetworkType && info.GotSignalStrength && info.GotCSQ) {
       int networkType = info.getNetworkTypeAsInt();
-      stats.update(info, networkType);
+      RATStats &stats = ratStats[networkType];
+      double cachedAge;
+      bool stale = getStaleAge(testMode, cachedAge);
+
+      // Once per poll, not per change
+      if (!stale)
+        stats.update(info);
 
       auto calculateSignalStrength = [](const float CSQ) {
         return (100.f / 31.99f) * CSQ;
@@ -378,32 +864,70 @@ int main(int argc, char **argv) {
           statsStr[0] = '\0';
       }
 
-      N = info.N;
+      if (stale) {
+        size_t len = strlen(str);
+        snprintf(str + len, sizeof(str) - len, " [Cached: %.0fs]", cachedAge);
+      }
+
+      if (showStats) {
+        formatLatencyStats(latencyStr, sizeof(latencyStr));
+
+        if (latencyStr[0]) {
+          size_t len = strlen(statsStr);
+          snprintf(statsStr + len, sizeof(statsStr) - len, "%s%s",
+                   len ? (pipe ? " " : "\n") : "", latencyStr);
+        }
+      }
     }
 
-    if (str[0]) {
-      clearScreen(forceClearScreen);
-      forceClearScreen = false;
+    if (backfill && pipe)
+      printSamples(sampleSequence);
+
+    if (delta) {
+      printDelta(deltaVersion);
+    } else if (str[0]) {
       char timeStr[64] = "";
+      char frame[4096];
       if (pipe) {
         time_t t = time(nullptr);
         strftime(timeStr, sizeof(timeStr), "[%Y-%m-%d - %H:%M:%S] | ", localtime(&t));
       }
-      printf(fmtStr, timeStr, str, int(time(nullptr) - info.LastUpdate), statsStr);
-      if (noClearScreen)
-        printf("\n");
-      fflush(stdout);
+      snprintf(frame, sizeof(frame), fmtStr, timeStr, str, getAge(info, testMode), statsStr);
+
+      // Only the changed cells, e.g. the age, are redrawn
+      if (noClearScreen) {
+        clearScreen(forceClearScreen);
+        forceClearScreen = false;
+        printf("%s\n", frame);
+        fflush(stdout);
+      } else {
+        renderer.render(frame);
+      }
     }
 
-    Sleep(updateInterval < 1000 ? updateInterval : 1000);
+    if (replayFinished)
+      break;
+
+    int timeout = replayFile ? 100 : updateInterval < 1000 ? updateInterval : 1000;
+
+#ifndef _WIN32
+    // Wake up as soon as there is a new snapshot
+    if (eventFD != -1) {
+      pollfd pfd = { eventFD, POLLIN, 0 };
+      poll(&pfd, 1, timeout);
+    } else
+#endif
+    Sleep(timeout);
   } while (!shouldExit);
 
+  renderer.finish();
   clearScreen();
   zte_mf283plus_watch::deinit();
+  zte_mf283plus_watch::stopRecording();
 
-#if defined(_WIN32) && defined(EXPERIMENTAL)
-  WSACleanup();
-#endif
+  if (replayFile && showStats)
+    printf("\nReplay finished after %.2fs\n",
+           std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count());
 
   return 0;
 }
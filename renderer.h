@@ -0,0 +1,195 @@
+/*
+  This is free and unencumbered software released into the public domain.
+
+  Anyone is free to copy, modify, publish, use, compile, sell, or
+  distribute this software, either in source code form or as a compiled
+  binary, for any purpose, commercial or non-commercial, and by any
+  means.
+
+  In jurisdictions that recognize copyright laws, the author or authors
+  of this software dedicate any and all copyright interest in the
+  software to the public domain. We make this dedication for the benefit
+  of the public at large and to the detriment of our heirs and
+  successors. We intend this dedication to be an overt act of
+  relinquishment in perpetuity of all present and future rights to this
+  software under copyright law.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+  OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+  OTHER DEALINGS IN THE SOFTWARE.
+
+  For more information, please refer to <http://unlicense.org/>
+*/
+
+// Differential terminal renderer of the CLI.
+// Included into an unnamed namespace by main.cpp.
+// Keeps the previous frame and only writes the cells which changed, as
+// cursor moves plus text, with a single write per frame. Lines are wrapped
+// at the terminal width so that every row maps to one screen row, a
+// changed width redraws everything.
+
+class Renderer {
+public:
+  Renderer() {
+#ifdef _WIN32
+    // Older consoles do not understand escape sequences
+    HANDLE console = GetStdHandle(STD_OUTPUT_HANDLE);
+    DWORD mode;
+    fallback = !GetConsoleMode(console, &mode) ||
+               !SetConsoleMode(console, mode | 0x0004 /* ENABLE_VIRTUAL_TERMINAL_PROCESSING */);
+#endif
+  }
+
+  void render(const char *text) {
+    if (fallback) {
+      clearScreen(true);
+      fputs(text, stdout);
+      fflush(stdout);
+      return;
+    }
+
+    int columns = terminalWidth();
+    out.clear();
+
+    if (!active || columns != width) {
+      out += "\e[?25l\e[1;1H\e[2J";
+      previous.clear();
+      width = columns;
+      active = true;
+    }
+
+    split(text);
+
+    for (size_t row = 0; row < rows.size(); ++row)
+      diffRow(row, row < previous.size() ? previous[row] : empty, rows[row]);
+
+    for (size_t row = rows.size(); row < previous.size(); ++row) {
+      moveTo(row, 0);
+      out += "\e[K";
+    }
+
+    std::swap(previous, rows);
+
+    if (!out.empty()) {
+      fwrite(out.data(), 1, out.size(), stdout);
+      fflush(stdout);
+    }
+  }
+
+  // Leaves the cursor below the frame and shows it again
+  void finish() {
+    if (!active)
+      return;
+
+    out.clear();
+    moveTo(previous.size(), 0);
+    out += "\e[?25h";
+    fwrite(out.data(), 1, out.size(), stdout);
+    fflush(stdout);
+    active = false;
+  }
+
+private:
+  static bool isContinuation(char c) {
+    return (c & 0xc0) == 0x80;
+  }
+
+  static int terminalWidth() {
+#ifdef _WIN32
+    CONSOLE_SCREEN_BUFFER_INFO csbi;
+    if (GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &csbi))
+      return csbi.dwSize.X;
+#else
+    winsize ws;
+    if (!ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) && ws.ws_col)
+      return ws.ws_col;
+#endif
+    return 0; // Unknown, do not wrap
+  }
+
+  // Splits text into rows of at most width characters (UTF-8)
+  void split(const char *text) {
+    size_t count = 0;
+
+    for (const char *line = text; *line; ) {
+      const char *end = strchr(line, '\n');
+      if (!end)
+        end = line + strlen(line);
+
+      const char *p = line;
+
+      do {
+        const char *start = p;
+        int column = 0;
+
+        while (p < end && (!width || column < width || isContinuation(*p))) {
+          if (!isContinuation(*p))
+            ++column;
+          ++p;
+        }
+
+        if (count == rows.size())
+          rows.emplace_back();
+
+        rows[count++].assign(start, p);
+      } while (p < end);
+
+      line = *end ? end + 1 : end;
+    }
+
+    rows.resize(count);
+  }
+
+  void moveTo(size_t row, size_t column) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "\e[%u;%uH", unsigned(row + 1), unsigned(column + 1));
+    out += buf;
+  }
+
+  void diffRow(size_t row, const std::string &before, const std::string &after) {
+    size_t common = 0;
+    size_t length = std::min(before.size(), after.size());
+
+    while (common < length && before[common] == after[common])
+      ++common;
+
+    if (common == after.size() && before.size() == after.size())
+      return;
+
+    while (common > 0 && isContinuation(after[common]))
+      --common;
+
+    size_t end = after.size();
+
+    // Same length: stop after the last changed character
+    if (before.size() == after.size()) {
+      while (end > common && before[end - 1] == after[end - 1])
+        --end;
+      while (end < after.size() && isContinuation(after[end]))
+        ++end;
+    }
+
+    size_t column = 0;
+
+    for (size_t i = 0; i < common; ++i)
+      column += !isContinuation(after[i]);
+
+    moveTo(row, column);
+    out.append(after, common, end - common);
+
+    if (after.size() < before.size())
+      out += "\e[K";
+  }
+
+  const std::string empty;
+  std::vector<std::string> rows;
+  std::vector<std::string> previous;
+  std::string out; // Escape sequences and text of the frame
+  int width = 0;
+  bool active = false;
+  bool fallback = false;
+};
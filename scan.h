@@ -0,0 +1,262 @@
+/*
+  This is free and unencumbered software released into the public domain.
+
+  Anyone is free to copy, modify, publish, use, compile, sell, or
+  distribute this software, either in source code form or as a compiled
+  binary, for any purpose, commercial or non-commercial, and by any
+  means.
+
+  In jurisdictions that recognize copyright laws, the author or authors
+  of this software dedicate any and all copyright interest in the
+  software to the public domain. We make this dedication for the benefit
+  of the public at large and to the detriment of our heirs and
+  successors. We intend this dedication to be an overt act of
+  relinquishment in perpetuity of all present and future rights to this
+  software under copyright law.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+  OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+  OTHER DEALINGS IN THE SOFTWARE.
+
+  For more information, please refer to <http://unlicense.org/>
+*/
+
+// Vectorized line splitting for the syslog parser.
+// Included into an unnamed namespace by zte_mf283plus_watch.cpp.
+//
+// Besides finding the line boundaries, the scanners flag whether a line
+// contains one of the bytes every record marker of parseLine() contains
+// ('+' of the AT responses, 'L' of "LAC=", 'P' of "ProcAtZrssiRes"), so
+// lines without one can be skipped without copying or parsing them.
+// The implementation is chosen once at runtime: AVX2, SSE2, NEON
+// (AArch64) or scalar.
+
+inline bool isMarkerByte(char c) {
+  return c == '+' || c == 'L' || c == 'P';
+}
+
+struct LineScanner {
+  const char *Name;
+  // Returns the end of the line starting at p ('\n' or end)
+  const char *(*Forward)(const char *p, const char *end, bool &marker);
+  // Returns the start of the line ending at p (excluding its '\n')
+  const char *(*Reverse)(const char *begin, const char *p, bool &marker);
+  // Whether the CPU can run it
+  bool (*Supported)();
+};
+
+// marker is only written once, a char store could alias anything
+
+const char *scanForwardScalar(const char *p, const char *end, bool &marker) {
+  const char *lineEnd = (const char *)memchr(p, '\n', end - p);
+  bool found = false;
+
+  if (!lineEnd)
+    lineEnd = end;
+
+  for (; p < lineEnd && !found; ++p)
+    found = isMarkerByte(*p);
+
+  marker |= found;
+  return lineEnd;
+}
+
+const char *scanReverseScalar(const char *begin, const char *p, bool &marker) {
+  bool found = false;
+
+  for (; p > begin && p[-1] != '\n'; --p)
+    found |= isMarkerByte(p[-1]);
+
+  marker |= found;
+  return p;
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__SSE2__))
+#define SCAN_X86
+
+// Shared by the SSE2 and AVX2 scanners. MASK returns one bit per byte of
+// the block at p: the newlines and the marker bytes.
+
+#define SCAN_FORWARD(WIDTH, MASK)                                            \
+  uint32_t found = 0;                                                        \
+                                                                             \
+  while (end - p >= WIDTH) {                                                 \
+    uint32_t newlines, markers;                                              \
+    MASK(p, newlines, markers);                                              \
+                                                                             \
+    if (newlines) {                                                          \
+      unsigned i = __builtin_ctz(newlines);                                  \
+      marker |= (found | (markers & ((1ull << i) - 1))) != 0;                \
+      return p + i;                                                          \
+    }                                                                        \
+                                                                             \
+    found |= markers;                                                        \
+    p += WIDTH;                                                              \
+  }                                                                          \
+                                                                             \
+  marker |= found != 0;                                                      \
+  return scanForwardScalar(p, end, marker);
+
+#define SCAN_REVERSE(WIDTH, MASK)                                            \
+  uint32_t found = 0;                                                        \
+                                                                             \
+  while (p - begin >= WIDTH) {                                               \
+    uint32_t newlines, markers;                                              \
+    MASK(p - WIDTH, newlines, markers);                                      \
+                                                                             \
+    if (newlines) {                                                          \
+      unsigned i = 31 - __builtin_clz(newlines);                             \
+      marker |= found || (uint64_t(markers) >> i) > 1;                       \
+      return p - WIDTH + i + 1;                                              \
+    }                                                                        \
+                                                                             \
+    found |= markers;                                                        \
+    p -= WIDTH;                                                              \
+  }                                                                          \
+                                                                             \
+  marker |= found != 0;                                                      \
+  return scanReverseScalar(begin, p, marker);
+
+__attribute__((target("sse2")))
+inline void maskSSE2(const char *p, uint32_t &newlines, uint32_t &markers) {
+  __m128i v = _mm_loadu_si128((const __m128i *)p);
+  __m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('+')),
+                                        _mm_cmpeq_epi8(v, _mm_set1_epi8('L'))),
+                           _mm_cmpeq_epi8(v, _mm_set1_epi8('P')));
+  newlines = uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n'))));
+  markers = uint32_t(_mm_movemask_epi8(m));
+}
+
+__attribute__((target("sse2")))
+const char *scanForwardSSE2(const char *p, const char *end, bool &marker) {
+  SCAN_FORWARD(16, maskSSE2)
+}
+
+__attribute__((target("sse2")))
+const char *scanReverseSSE2(const char *begin, const char *p, bool &marker) {
+  SCAN_REVERSE(16, maskSSE2)
+}
+
+__attribute__((target("avx2")))
+inline void maskAVX2(const char *p, uint32_t &newlines, uint32_t &markers) {
+  __m256i v = _mm256_loadu_si256((const __m256i *)p);
+  __m256i m = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('+')),
+                                              _mm256_cmpeq_epi8(v, _mm256_set1_epi8('L'))),
+                              _mm256_cmpeq_epi8(v, _mm256_set1_epi8('P')));
+  newlines = uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n'))));
+  markers = uint32_t(_mm256_movemask_epi8(m));
+}
+
+__attribute__((target("avx2")))
+const char *scanForwardAVX2(const char *p, const char *end, bool &marker) {
+  SCAN_FORWARD(32, maskAVX2)
+}
+
+__attribute__((target("avx2")))
+const char *scanReverseAVX2(const char *begin, const char *p, bool &marker) {
+  SCAN_REVERSE(32, maskAVX2)
+}
+
+#undef SCAN_FORWARD
+#undef SCAN_REVERSE
+#endif
+
+#if defined(__aarch64__)
+#define SCAN_NEON
+
+// NEON has no movemask, narrowing the comparison result yields 4 bits
+// per byte instead
+
+inline void maskNEON(const char *p, uint64_t &newlines, uint64_t &markers) {
+  uint8x16_t v = vld1q_u8((const uint8_t *)p);
+  uint8x16_t m = vorrq_u8(vorrq_u8(vceqq_u8(v, vdupq_n_u8('+')), vceqq_u8(v, vdupq_n_u8('L'))),
+                          vceqq_u8(v, vdupq_n_u8('P')));
+  uint8x16_t n = vceqq_u8(v, vdupq_n_u8('\n'));
+  newlines = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(n), 4)), 0);
+  markers = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(m), 4)), 0);
+}
+
+const char *scanForwardNEON(const char *p, const char *end, bool &marker) {
+  uint64_t found = 0;
+
+  while (end - p >= 16) {
+    uint64_t newlines, markers;
+    maskNEON(p, newlines, markers);
+
+    if (newlines) {
+      unsigned i = __builtin_ctzll(newlines);
+      marker |= (found | (markers & ((1ull << i) - 1))) != 0;
+      return p + i / 4;
+    }
+
+    found |= markers;
+    p += 16;
+  }
+
+  marker |= found != 0;
+  return scanForwardScalar(p, end, marker);
+}
+
+const char *scanReverseNEON(const char *begin, const char *p, bool &marker) {
+  uint64_t found = 0;
+
+  while (p - begin >= 16) {
+    uint64_t newlines, markers;
+    maskNEON(p - 16, newlines, markers);
+
+    if (newlines) {
+      unsigned i = 63 - __builtin_clzll(newlines); // highest bit of the nibble
+      marker |= found || (i < 63 && (markers >> (i + 1)) != 0);
+      return p - 16 + i / 4 + 1;
+    }
+
+    found |= markers;
+    p -= 16;
+  }
+
+  marker |= found != 0;
+  return scanReverseScalar(begin, p, marker);
+}
+#endif
+
+bool anyCPU() { return true; }
+
+#ifdef SCAN_X86
+bool hasAVX2() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+}
+
+bool hasSSE2() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("sse2");
+}
+#endif
+
+// Every scanner built for this target, best first
+const LineScanner lineScanners[] = {
+#ifdef SCAN_X86
+  { "AVX2", scanForwardAVX2, scanReverseAVX2, hasAVX2 },
+  { "SSE2", scanForwardSSE2, scanReverseSSE2, hasSSE2 },
+#endif
+#ifdef SCAN_NEON
+  { "NEON", scanForwardNEON, scanReverseNEON, anyCPU },
+#endif
+  { "scalar", scanForwardScalar, scanReverseScalar, anyCPU }
+};
+
+const LineScanner &selectLineScanner() {
+  for (const LineScanner &scanner : lineScanners) {
+    if (scanner.Supported())
+      return scanner;
+  }
+
+  return lineScanners[countOf(lineScanners) - 1];
+}
+
+// A copy, so that bench/parse_bench.cpp can run the parser with each one
+LineScanner lineScanner = selectLineScanner();
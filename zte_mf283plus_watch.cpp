@@ -30,19 +30,50 @@
 #include <string>
 #include <algorithm>
 #include <thread>
+#include <future>
 #include <mutex>
+#include <condition_variable>
 #include <atomic>
+#include <chrono>
+#include <deque>
+#include <vector>
+#include <cstddef>
+#include <memory>
 #include <cstdlib>
 #include <cstring>
 #include <cmath>
+#include <cstdio>
+#include <new>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__SSE2__))
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+#ifndef NO_CURL
 #include <curl/curl.h>
+#endif
 
 //#define TEST
 
 #ifndef _WIN32
 #include <unistd.h>
-#define Sleep(ms) usleep(ms * 1000)
+#include <fcntl.h>
+#include <poll.h>
+#include <netdb.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <cerrno>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+#define Sleep(ms) usleep((ms) * 1000)
 #else
+#ifdef NO_CURL
+#error "The built-in HTTP client is not available on Windows"
+#endif
 #include <windows.h>
 #endif
 
@@ -53,21 +84,109 @@ namespace {
 #include "base64.c"
 }
 
+#ifdef ALLOC_CHECK
+// Counting allocator, built by ALLOC_CHECK=1 ./compile.sh. The update
+// thread sets allocCheck after ALLOC_CHECK_WARMUP polls, any further
+// operator new on that thread aborts. libcurl allocates with malloc()
+// and is not covered, use TRANSPORT_BUILTIN for a complete check.
+
+#ifndef ALLOC_CHECK_WARMUP
+#define ALLOC_CHECK_WARMUP 30
+#endif
+
+namespace {
+thread_local bool allocCheck;
+std::atomic<uint64_t> allocCount;
+}
+
+void *operator new(size_t size) {
+  if (allocCheck) {
+    fprintf(stderr, "ALLOC_CHECK: %zu byte allocation after warm-up (%llu before)\n",
+            size, (unsigned long long)allocCount.load());
+    abort();
+  }
+
+  ++allocCount;
+
+  if (void *p = malloc(size ? size : 1))
+    return p;
+
+  throw std::bad_alloc();
+}
+
+void *operator new[](size_t size) { return operator new(size); }
+// Not inlined, GCC would take free() of new'd memory for a mismatch
+__attribute__((noinline)) void operator delete(void *p) noexcept { free(p); }
+__attribute__((noinline)) void operator delete[](void *p) noexcept { free(p); }
+#endif
+
 #include "zte_mf283plus_watch.h"
 
 namespace zte_mf283plus_watch {
 
+namespace {
+
+const NetworkTypeInfo networkTypes[NETWORK_TYPE_COUNT] = {
+  { "",                3, RAT_UNKNOWN },
+  { "No Service",      0, RAT_NONE },
+  { "Limited Service", 0, RAT_NONE },
+  { "GSM",             2, RAT_GERAN },
+  { "GPRS",            2, RAT_GERAN },
+  { "EDGE",            2, RAT_GERAN },
+  { "E-EDGE",          2, RAT_GERAN },
+  { "UMTS",            3, RAT_UTRAN },
+  { "WCDMA",           3, RAT_UTRAN },
+  { "TD-SCDMA",        3, RAT_UTRAN },
+  { "HSDPA",           3, RAT_UTRAN },
+  { "HSUPA",           3, RAT_UTRAN },
+  { "HSPA",            3, RAT_UTRAN },
+  { "HSPA+",           3, RAT_UTRAN },
+  { "DC-HSPA+",        3, RAT_UTRAN },
+  { "LTE",             4, RAT_EUTRAN }
+};
+
+// Perfect hash over the known network type strings.
+// networkTypeSlots[] must be regenerated when a string is added.
+
+unsigned networkTypeHash(const char *s, size_t len) {
+  return (len * 2 + (unsigned char)s[0] * 5 + (unsigned char)s[len - 1] +
+          (unsigned char)s[len / 2] * 5) & 31;
+}
+
+const uint8_t networkTypeSlots[32] = {
+  NETWORK_TYPE_UNKNOWN, NETWORK_TYPE_HSPA, NETWORK_TYPE_UNKNOWN, NETWORK_TYPE_UNKNOWN,
+  NETWORK_TYPE_TD_SCDMA, NETWORK_TYPE_UNKNOWN, NETWORK_TYPE_UNKNOWN, NETWORK_TYPE_HSDPA,
+  NETWORK_TYPE_UMTS, NETWORK_TYPE_EDGE, NETWORK_TYPE_UNKNOWN, NETWORK_TYPE_LTE,
+  NETWORK_TYPE_UNKNOWN, NETWORK_TYPE_HSPA_PLUS, NETWORK_TYPE_DC_HSPA_PLUS, NETWORK_TYPE_UNKNOWN,
+  NETWORK_TYPE_UNKNOWN, NETWORK_TYPE_UNKNOWN, NETWORK_TYPE_WCDMA, NETWORK_TYPE_UNKNOWN,
+  NETWORK_TYPE_UNKNOWN, NETWORK_TYPE_GSM, NETWORK_TYPE_UNKNOWN, NETWORK_TYPE_UNKNOWN,
+  NETWORK_TYPE_GPRS, NETWORK_TYPE_NO_SERVICE, NETWORK_TYPE_UNKNOWN, NETWORK_TYPE_UNKNOWN,
+  NETWORK_TYPE_HSUPA, NETWORK_TYPE_UNKNOWN, NETWORK_TYPE_E_EDGE, NETWORK_TYPE_LIMITED_SERVICE
+};
+
+} // unnamed namespace
+
+NetworkTypeID classifyNetworkType(const char *networkType) {
+  size_t len = strlen(networkType);
+
+  if (!len)
+    return NETWORK_TYPE_UNKNOWN;
+
+  NetworkTypeID id = NetworkTypeID(networkTypeSlots[networkTypeHash(networkType, len)]);
+
+  return !strcmp(networkTypes[id].Name, networkType) ? id : NETWORK_TYPE_UNKNOWN;
+}
+
+const NetworkTypeInfo &getNetworkTypeInfo(NetworkTypeID id) {
+  return networkTypes[id < NETWORK_TYPE_COUNT ? id : NETWORK_TYPE_UNKNOWN];
+}
+
+NetworkTypeID Info::getNetworkTypeID() const {
+  return classifyNetworkType(NetworkType);
+}
+
 int Info::getNetworkTypeAsInt() const {
-  if (!strcmp(NetworkType, "LTE"))
-    return 4;
-  else if (!strcmp(NetworkType, "GSM") || !strcmp(NetworkType, "GPRS") ||
-           !strcmp(NetworkType, "EDGE") || !strcmp(NetworkType, "E-EDGE"))
-    return 2;
-  else if (!strcmp(NetworkType, "No Service") ||
-           !strcmp(NetworkType, "Limited Service"))
-    return 0;
-  else
-    return 3;
+  return getNetworkTypeInfo(getNetworkTypeID()).Generation;
 }
 
 void Info::reset() {
@@ -90,312 +209,2573 @@ Info::Info() { reset(); }
 
 namespace {
 
+// Request strings are built once by init(), polling does not allocate
 std::string routerIP;
-std::string routerPW;
+std::string routerURL;     // "http://<routerIP>"
+std::string refererURL;    // "http://<routerIP>/index.html"
+std::string loginPOSTData;
 int updateInterval;
 std::thread *updateThreadHandle;
 std::atomic_bool deinitRequest;
+std::atomic_bool replayFinished;
+bool replaying;
+std::atomic<int> parseMode(PARSE_REVERSE);
+std::atomic<unsigned> parseThreads;
+std::atomic<int> dataSource(DATA_SOURCE_SYSLOG);
+std::atomic_bool conditionalFetch;
+std::atomic<uint64_t> skippedPolls;
+std::atomic_bool backfill;
+std::atomic_bool firstSnapshot;
+int64_t initStartMono;
+std::atomic<uint64_t> firstSampleUs; // 0 until the first sample got published
+std::atomic<int> initState(INIT_STATE_IDLE);
+
+// Last complete state seen on a radio access technology, indexed by
+// generation (0, 2, 3, 4)
+
+struct RATCacheEntry {
+  Info info;
+  int64_t routerTime;
+  bool valid;
+};
+
+// Midnight of the last date parsed by parseSyslogTime(), kept by every
+// parser instead of in statics
+
+struct SyslogDate {
+  int month = -1;
+  int day = -1;
+  int64_t midnight = 0;
+};
+
+struct ParseState {
+  NetworkTypeID networkType; // of the published Info
+  int64_t routerTime;        // syslog time of the current signal values
+  int64_t networkTypeTime;   // syslog time of the current network type
+  bool stale;                // measurements were restored from ratCache
+  RATCacheEntry ratCache[5];
+  SyslogDate date;
+
+  void resetNetwork() {
+    networkType = NETWORK_TYPE_UNKNOWN;
+    routerTime = 0;
+    networkTypeTime = 0;
+    stale = false;
+  }
+
+  void reset() {
+    resetNetwork();
+
+    for (RATCacheEntry &entry : ratCache)
+      entry.valid = false;
+  }
+};
+
+struct Timestamp {
+  int64_t mono;
+  int64_t wall;
+
+  static Timestamp now();
+};
+
+Info info;
+InfoV2 infoV2;
+ParseState parseState;
+std::mutex mutex;
+
+// See getEventFD(). With eventfd both ends are the same descriptor, the
+// write end is published first.
+std::mutex eventFDMutex;
+std::atomic<int> eventReadFD(-1);
+std::atomic<int> eventWriteFD(-1);
+
+// One-shot notifications, see notifyOnce()
+
+struct Notification {
+  NotifyCallback callback;
+  void *data;
+};
+
+std::mutex notifyMutex;
+std::vector<Notification> notifications[NOTIFY_EVENT_COUNT];
+
+void notify(NotifyEvent event) {
+  std::vector<Notification> pending;
+
+  {
+    std::lock_guard<std::mutex> lock(notifyMutex);
+
+    if (notifications[event].empty())
+      return;
+
+    pending.swap(notifications[event]);
+  }
+
+  for (const Notification &notification : pending)
+    notification.callback(notification.data);
+}
+
+void signalEvent() {
+#ifndef _WIN32
+  int fd = eventWriteFD;
+
+  if (fd == -1)
+    return;
+
+#ifdef __linux__
+  uint64_t one = 1;
+  ssize_t rc = write(fd, &one, sizeof(one));
+#else
+  char one = 1;
+  ssize_t rc = write(fd, &one, sizeof(one)); // A full pipe is readable anyway
+#endif
+  (void)rc;
+#endif
+}
+
+void drainEvent() {
+#ifndef _WIN32
+  int fd = eventReadFD;
+
+  if (fd == -1)
+    return;
+
+  char buf[64];
+  while (read(fd, buf, sizeof(buf)) > 0);
+#endif
+}
+
+// Interned Info::ProviderDesc strings, ID 0 is the empty string.
+// The deque keeps the returned pointers valid.
+
+std::deque<std::string> providerNames(1);
+std::mutex providerMutex;
+
+int16_t toInt16(int v) {
+  return int16_t(v > INT16_MIN && v <= INT16_MAX ? v : INFO_V2_NOT_AVAILABLE);
+}
+
+uint16_t internProvider(const char *name) {
+  std::lock_guard<std::mutex> lock(providerMutex);
+
+  for (size_t i = 0; i < providerNames.size(); ++i)
+    if (providerNames[i] == name)
+      return uint16_t(i);
+
+  if (providerNames.size() > UINT16_MAX)
+    return 0;
+
+  providerNames.push_back(name);
+  return uint16_t(providerNames.size() - 1);
+}
+
+// Lock-free log-linear (HDR style) latency histogram.
+// Values are in microseconds, the relative bucket error is ~6%.
+
+class Histogram {
+public:
+  void record(uint64_t us) {
+    if (us > MAX_VALUE)
+      us = MAX_VALUE;
+
+    buckets[bucketIndex(us)].fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add(us, std::memory_order_relaxed);
+
+    uint64_t cur = min.load(std::memory_order_relaxed);
+    while (us < cur && !min.compare_exchange_weak(cur, us, std::memory_order_relaxed));
+
+    cur = max.load(std::memory_order_relaxed);
+    while (us > cur && !max.compare_exchange_weak(cur, us, std::memory_order_relaxed));
+  }
+
+  void get(PhaseStats &stats) const {
+    uint64_t counts[BUCKET_COUNT];
+    uint64_t total = 0;
+
+    for (unsigned i = 0; i < BUCKET_COUNT; ++i)
+      total += counts[i] = buckets[i].load(std::memory_order_relaxed);
+
+    stats.Count = total;
+    stats.MinUs = total ? min.load(std::memory_order_relaxed) : 0;
+    stats.MaxUs = max.load(std::memory_order_relaxed);
+    stats.AvgUs = total ? sum.load(std::memory_order_relaxed) / total : 0;
+    stats.P50Us = percentile(counts, total, 50, stats.MaxUs);
+    stats.P90Us = percentile(counts, total, 90, stats.MaxUs);
+    stats.P99Us = percentile(counts, total, 99, stats.MaxUs);
+  }
+
+  void reset() {
+    for (auto &bucket : buckets)
+      bucket.store(0, std::memory_order_relaxed);
+
+    sum.store(0, std::memory_order_relaxed);
+    min.store(uint64_t(-1), std::memory_order_relaxed);
+    max.store(0, std::memory_order_relaxed);
+  }
+
+  Histogram() { reset(); }
+
+private:
+  static const unsigned SUB_BITS = 4;
+  static const unsigned SUB_COUNT = 1 << SUB_BITS;
+  static const unsigned BUCKET_COUNT = (32 - SUB_BITS + 1) * SUB_COUNT;
+  static const uint64_t MAX_VALUE = 0xffffffffULL;
+
+  static unsigned bucketIndex(uint64_t v) {
+    if (v < SUB_COUNT)
+      return unsigned(v);
+
+    unsigned shift = (63 - __builtin_clzll(v)) - SUB_BITS;
+    return (shift << SUB_BITS) + unsigned(v >> shift);
+  }
+
+  static uint64_t bucketUpperBound(unsigned i) {
+    if (i < 2 * SUB_COUNT)
+      return i;
+
+    unsigned shift = (i >> SUB_BITS) - 1;
+    return ((uint64_t(i - (shift << SUB_BITS)) + 1) << shift) - 1;
+  }
+
+  static uint64_t percentile(const uint64_t *counts, uint64_t total,
+                             unsigned p, uint64_t max) {
+    if (!total)
+      return 0;
+
+    uint64_t target = (total * p + 99) / 100;
+    uint64_t seen = 0;
+
+    for (unsigned i = 0; i < BUCKET_COUNT; ++i) {
+      if ((seen += counts[i]) >= target)
+        return std::min(bucketUpperBound(i), max);
+    }
+
+    return max;
+  }
+
+  std::atomic<uint64_t> buckets[BUCKET_COUNT];
+  std::atomic<uint64_t> sum;
+  std::atomic<uint64_t> min;
+  std::atomic<uint64_t> max;
+};
+
+Histogram histograms[PHASE_COUNT];
+
+uint64_t elapsedUs(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now() - start).count();
+}
+
+struct RequestTimes { // us since the start of the request
+  uint64_t NameLookup;
+  uint64_t Connect;
+  uint64_t StartTransfer;
+  uint64_t Total;
+};
+
+enum RequestKind {
+  REQUEST_FULL, // GET, or POST if there is POST data
+  REQUEST_HEAD,
+  REQUEST_TAIL  // GET of the last TAIL_BYTES bytes
+};
+
+const int TAIL_BYTES = 512;
+
+// Response headers used to detect changes, see OPT_CONDITIONAL_FETCH
+struct Response {
+  long Status;
+  long long ContentLength; // -1: unknown
+  long long TotalLength;   // of a partial response, -1: unknown
+  char ETag[128];
+  char LastModified[64];
+
+  Response() : Status(0), ContentLength(-1), TotalLength(-1), ETag(), LastModified() {}
+};
+
+void parseResponseHeader(const char *line, size_t length, Response &response) {
+  auto value = [&](const char *name, char *buf, size_t size) {
+    size_t n = strlen(name);
+
+    if (length < n || strncasecmp(line, name, n))
+      return false;
+
+    const char *begin = line + n;
+    const char *end = line + length;
+
+    while (begin < end && (*begin == ' ' || *begin == '\t'))
+      ++begin;
+
+    while (end > begin && (end[-1] == '\r' || end[-1] == '\n' || end[-1] == ' '))
+      --end;
+
+    snprintf(buf, size, "%.*s", int(end - begin), begin);
+    return true;
+  };
+
+  char tmp[64];
+
+  if (length > 9 && !strncmp(line, "HTTP/", 5)) {
+    const char *space = (const char *)memchr(line, ' ', length);
+    response = Response();
+    response.Status = space ? atol(space + 1) : 0;
+  } else if (value("Content-Length:", tmp, sizeof(tmp))) {
+    response.ContentLength = atoll(tmp);
+  } else if (value("Content-Range:", tmp, sizeof(tmp))) {
+    const char *total = strchr(tmp, '/');
+    response.TotalLength = (total && total[1] != '*') ? atoll(total + 1) : -1;
+  } else if (!value("ETag:", response.ETag, sizeof(response.ETag))) {
+    value("Last-Modified:", response.LastModified, sizeof(response.LastModified));
+  }
+}
+
+#include "bands.h"
+#include "json.h"
+#ifndef _WIN32
+#include "http_client.h"
+#endif
+
+void recordRequestTimes(const RequestTimes &times) {
+  auto delta = [](uint64_t a, uint64_t b) { return a > b ? a - b : 0; };
+
+  histograms[PHASE_NAMELOOKUP].record(times.NameLookup);
+  histograms[PHASE_CONNECT].record(delta(times.Connect, times.NameLookup));
+  histograms[PHASE_STARTTRANSFER].record(delta(times.StartTransfer, times.Connect));
+  histograms[PHASE_TRANSFER].record(delta(times.Total, times.StartTransfer));
+  histograms[PHASE_TOTAL].record(times.Total);
+}
+
+#ifdef NO_CURL
+std::atomic<int> transport(TRANSPORT_BUILTIN);
+#else
+std::atomic<int> transport(TRANSPORT_CURL);
+#endif
+
+// Per connection transport state. The update thread uses mainConnection,
+// the handles are reused to keep the connection and curl's buffers alive.
+
+struct Connection {
+#ifndef _WIN32
+  HTTPClient httpClient;
+#endif
+#ifndef NO_CURL
+  CURL *curl = nullptr;
+  std::string curlURL;
+#endif
+  int connectTimeoutMs = 30000;
+
+  void setConnectTimeout(int timeoutMs) {
+    connectTimeoutMs = timeoutMs;
+#ifndef _WIN32
+    httpClient.setConnectTimeout(timeoutMs);
+#endif
+  }
+
+  void close() {
+#ifndef _WIN32
+    httpClient.close();
+#endif
+#ifndef NO_CURL
+    if (curl) {
+      curl_easy_cleanup(curl);
+      curl = nullptr;
+    }
+#endif
+  }
+};
+
+Connection mainConnection;
+
+// Size of the response buffer, reserved once by the update thread. The
+// router's syslogd rotates /messages at 200 KiB (the BusyBox default), so
+// a full syslog fits with room to spare and growing logs never reallocate.
+const size_t RESPONSE_CAPACITY = 512 * 1024;
+
+bool transportInit() {
+#ifndef NO_CURL
+  if (curl_global_init(CURL_GLOBAL_DEFAULT) != CURLE_OK)
+    return false;
+#endif
+  return true;
+}
+
+void transportCleanup() {
+  mainConnection.close();
+#ifndef NO_CURL
+  curl_global_cleanup();
+#endif
+}
+
+bool httpRequest(const char *request, std::string &buf, const char *POSTData = nullptr,
+                 Response *response = nullptr, RequestKind kind = REQUEST_FULL,
+                 Connection &connection = mainConnection);
+
+int login(std::string &data, Connection &connection = mainConnection) {
+  if (!httpRequest("/goform/goform_set_cmd_process", data, loginPOSTData.c_str(),
+                   nullptr, REQUEST_FULL, connection))
+    return -1;
+
+  if (data.empty() || data.length() >= 20 || data[0] != '{')
+    return -2;
+
+  return data == R"({"result":"0"})" ? 1 : -3;
+}
+
+// Record / replay of raw HTTP responses.
+//
+// File layout: the 8 byte magic followed by records of
+//   int64 wall clock time in ns, uint8 request path length, uint32 body
+//   length, request path, body
+// All integers are little endian.
+
+const char RECORD_MAGIC[8] = { '3', 'W', 'G', '3', 'R', 'E', 'C', '\x01' };
+
+FILE *recordFile;
+std::mutex recordMutex;
+
+int64_t wallClockNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+void writeLE(FILE *f, uint64_t v, size_t bytes) {
+  unsigned char buf[8];
+
+  for (size_t i = 0; i < bytes; ++i)
+    buf[i] = (unsigned char)(v >> (i * 8));
+
+  fwrite(buf, 1, bytes, f);
+}
+
+bool readLE(FILE *f, uint64_t &v, size_t bytes) {
+  unsigned char buf[8];
+
+  if (fread(buf, 1, bytes, f) != bytes)
+    return false;
+
+  v = 0;
+
+  for (size_t i = 0; i < bytes; ++i)
+    v |= uint64_t(buf[i]) << (i * 8);
+
+  return true;
+}
+
+void recordResponse(const char *request, const std::string &body) {
+  std::lock_guard<std::mutex> lock(recordMutex);
+
+  if (!recordFile)
+    return;
+
+  size_t requestLength = std::min<size_t>(strlen(request), 255);
+
+  writeLE(recordFile, uint64_t(wallClockNs()), 8);
+  writeLE(recordFile, requestLength, 1);
+  writeLE(recordFile, body.length(), 4);
+  fwrite(request, 1, requestLength, recordFile);
+  fwrite(body.data(), 1, body.length(), recordFile);
+  fflush(recordFile);
+}
+
+bool readRecord(FILE *f, int64_t &time, char (&request)[256], std::string &body) {
+  uint64_t t, requestLength, bodyLength;
+
+  if (!readLE(f, t, 8) || !readLE(f, requestLength, 1) || !readLE(f, bodyLength, 4))
+    return false;
+
+  if (fread(request, 1, requestLength, f) != requestLength)
+    return false;
+
+  request[requestLength] = '\0';
+  body.resize(bodyLength);
+
+  if (bodyLength && fread(&body[0], 1, bodyLength, f) != bodyLength)
+    return false;
+
+  time = int64_t(t);
+  return true;
+}
+
+#ifndef NO_CURL
+bool curlRequest(const char *request, std::string &buf, const char *POSTData,
+                 Response &response, RequestKind kind, Connection &connection) {
+  CURL *&curl = connection.curl;
+
+  if (!curl && !(curl = curl_easy_init()))
+    abort();
+
+  curl_easy_reset(curl);
+  connection.curlURL.assign(routerURL).append(request);
+
+  auto callback = [](void *data, size_t size, size_t nmemb, std::string &buf) {
+    buf.append((const char *)data, size * nmemb);
+    return size * nmemb;
+  };
+
+  auto headerCallback = [](char *data, size_t size, size_t nmemb, Response &response) {
+    parseResponseHeader(data, size * nmemb, response);
+    return size * nmemb;
+  };
+
+  buf.clear();
+
+#define SET_CURL_OPT(OPT, VAL)                                               \
+  if (curl_easy_setopt(curl, OPT, VAL) != CURLE_OK)                          \
+    abort();
+
+  SET_CURL_OPT(CURLOPT_CONNECTTIMEOUT_MS, long(connection.connectTimeoutMs));
+  SET_CURL_OPT(CURLOPT_TIMEOUT, 30L);
+  SET_CURL_OPT(CURLOPT_URL, connection.curlURL.c_str());
+
+  SET_CURL_OPT(CURLOPT_REFERER, refererURL.c_str());
+
+  if (POSTData)
+    SET_CURL_OPT(CURLOPT_POSTFIELDS, POSTData);
+
+  if (kind == REQUEST_HEAD)
+    SET_CURL_OPT(CURLOPT_NOBODY, 1L);
+
+  char range[32];
+
+  if (kind == REQUEST_TAIL) {
+    snprintf(range, sizeof(range), "-%d", TAIL_BYTES);
+    SET_CURL_OPT(CURLOPT_RANGE, range);
+  }
+
+  SET_CURL_OPT(CURLOPT_HEADERFUNCTION, +headerCallback);
+  SET_CURL_OPT(CURLOPT_HEADERDATA, &response);
+  SET_CURL_OPT(CURLOPT_WRITEFUNCTION, +callback);
+  SET_CURL_OPT(CURLOPT_WRITEDATA, &buf);
+  SET_CURL_OPT(CURLOPT_NOSIGNAL, 1L);
+
+  bool res = curl_easy_perform(curl) == CURLE_OK;
+
+  if (res) {
+    double nameLookup, connect, startTransfer, total;
+
+    if (curl_easy_getinfo(curl, CURLINFO_NAMELOOKUP_TIME, &nameLookup) == CURLE_OK &&
+        curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME, &connect) == CURLE_OK &&
+        curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME, &startTransfer) == CURLE_OK &&
+        curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME, &total) == CURLE_OK) {
+      auto us = [](double s) { return uint64_t(s > 0.0 ? s * 1e6 + .5 : 0.0); };
+      recordRequestTimes({ us(nameLookup), us(connect), us(startTransfer), us(total) });
+    }
+  }
+
+  return res;
+}
+#endif
+
+bool httpRequest(const char *request, std::string &buf, const char *POSTData,
+                 Response *response, RequestKind kind, Connection &connection) {
+  Response tmp;
+  bool res = false;
+
+  if (!response)
+    response = &tmp;
+
+#ifndef _WIN32
+  if (transport == TRANSPORT_BUILTIN) {
+    RequestTimes times;
+
+    res = connection.httpClient.request(routerIP.c_str(), request, POSTData, kind, 30000,
+                                        buf, *response, times);
+
+    if (res)
+      recordRequestTimes(times);
+  }
+#endif
+#ifndef NO_CURL
+  if (transport == TRANSPORT_CURL)
+    res = curlRequest(request, buf, POSTData, *response, kind, connection);
+#endif
+
+  // Probes are not recorded, replay only needs the full responses
+  if (res && kind == REQUEST_FULL)
+    recordResponse(request, buf);
+
+  return res;
+}
+
+#include "scan.h"
+
+// Lines without a record marker byte are skipped, see scan.h
+
+template <typename BUF, size_t N>
+bool getLine(const char *&str, const char *end, BUF (&buf)[N]) {
+  static_assert(N > 1, "");
+
+  while (str < end) {
+    const char *start = str;
+    bool marker = false;
+    const char *lineEnd = lineScanner.Forward(str, end, marker);
+
+    str = lineEnd < end ? lineEnd + 1 : end;
+
+    if (!marker)
+      continue;
+
+    size_t length = std::min<size_t>(N - 1, lineEnd - start);
+    memcpy(buf, start, length);
+    buf[length] = '\0';
+
+    return true;
+  }
+
+  return false;
+}
+
+template <typename BUF, size_t N>
+bool getLineReverse(const char *begin, const char *&end, BUF (&buf)[N]) {
+  static_assert(N > 1, "");
+
+  while (end > begin) {
+    const char *lineEnd = end;
+
+    if (lineEnd[-1] == '\n')
+      --lineEnd;
+
+    bool marker = false;
+    const char *start = lineScanner.Reverse(begin, lineEnd, marker);
+
+    end = start;
+
+    if (!marker)
+      continue;
+
+    size_t length = std::min<size_t>(N - 1, lineEnd - start);
+    memcpy(buf, start, length);
+    buf[length] = '\0';
+
+    return true;
+  }
+
+  return false;
+}
+
+const size_t NPOS = size_t(-1);
+
+size_t find(const char *s, const char *f) {
+  const char *p = strstr(s, f);
+  return p ? p - s : NPOS;
+}
+
+// Reentrant localtime()
+bool localTime(time_t t, struct tm &tm) {
+#ifdef _WIN32
+  return !localtime_s(&tm, &t);
+#else
+  return localtime_r(&t, &tm) != nullptr;
+#endif
+}
+
+// Syslog timestamps ("Jan  1 00:01:23 ...") carry no year, the current
+// one is assumed unless that would put the line into the future.
+
+int64_t parseSyslogTime(const char *line, SyslogDate &date) {
+  static const char months[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+  int month = 0, day, hour, minute, second;
+
+  while (month < 12 && strncmp(line, months + month * 3, 3))
+    ++month;
+
+  if (month == 12 || sscanf(line + 3, "%d %d:%d:%d", &day, &hour, &minute, &second) != 4)
+    return 0;
+
+  if (month != date.month || day != date.day) {
+    time_t now = time(nullptr);
+    struct tm tm;
+
+    if (!localTime(now, tm))
+      return 0;
+
+    tm.tm_mon = month;
+    tm.tm_mday = day;
+    tm.tm_hour = tm.tm_min = tm.tm_sec = 0;
+    tm.tm_isdst = -1;
+
+    time_t midnight = mktime(&tm);
+
+    if (midnight > now + 24 * 60 * 60) {
+      tm.tm_year--;
+      tm.tm_isdst = -1;
+      midnight = mktime(&tm);
+    }
+
+    date.month = month;
+    date.day = day;
+    date.midnight = int64_t(midnight);
+  }
+
+  return (date.midnight + hour * 3600 + minute * 60 + second) * 1000000000LL;
+}
+
+// Info fields are written in groups, a line either writes all members of
+// a group or none of them. This allows to merge the results of lines
+// parsed out of order.
+
+enum FieldGroup : unsigned {
+  GROUP_NETWORK_TYPE  = 1 << 0, // NetworkType
+  GROUP_SIGNAL        = 1 << 1, // RSRP, RSCP, RSRQ, RSSI, SINR, ECIO
+  GROUP_CSQ           = 1 << 2, // CSQ
+  GROUP_LAC           = 1 << 3, // LAC
+  GROUP_CELL_ID       = 1 << 4, // GlobalCellID
+  GROUP_PROVIDER_DESC = 1 << 5, // ProviderDesc
+  GROUP_PROVIDER_ID   = 1 << 6, // MCCMNC
+  GROUP_FREQUENCY     = 1 << 7, // Frequency
+  GROUP_CHANNEL       = 1 << 8  // Channel
+};
+
+const unsigned ALL_GROUPS = (GROUP_CHANNEL << 1) - 1;
+
+// Measurements restored from the per-RAT cache after a network switch
+const unsigned CACHED_GROUPS = GROUP_SIGNAL | GROUP_CSQ | GROUP_LAC | GROUP_CELL_ID |
+                               GROUP_FREQUENCY | GROUP_CHANNEL;
+
+void copyGroups(const Info &src, Info &dst, unsigned groups) {
+  if (groups & GROUP_NETWORK_TYPE) {
+    memcpy(dst.NetworkType, src.NetworkType, sizeof(dst.NetworkType));
+    dst.GotNetworkType = src.GotNetworkType;
+  }
+  if (groups & GROUP_SIGNAL) {
+    dst.RSRP = src.RSRP; dst.RSCP = src.RSCP;
+    dst.RSRQ = src.RSRQ; dst.RSSI = src.RSSI;
+    dst.SINR = src.SINR; dst.ECIO = src.ECIO;
+    dst.GotSignalStrength = src.GotSignalStrength;
+  }
+  if (groups & GROUP_CSQ) {
+    dst.CSQ = src.CSQ;
+    dst.GotCSQ = src.GotCSQ;
+  }
+  if (groups & GROUP_LAC) {
+    dst.LAC = src.LAC;
+    dst.GotLAC = src.GotLAC;
+  }
+  if (groups & GROUP_CELL_ID) {
+    dst.GlobalCellID = src.GlobalCellID;
+    dst.GotCellID = src.GotCellID;
+  }
+  if (groups & GROUP_PROVIDER_DESC)
+    memcpy(dst.ProviderDesc, src.ProviderDesc, sizeof(dst.ProviderDesc));
+  if (groups & GROUP_PROVIDER_ID) {
+    dst.MCCMNC = src.MCCMNC;
+    dst.GotProviderInfo = src.GotProviderInfo;
+  }
+  if (groups & GROUP_FREQUENCY) {
+    dst.Frequency = src.Frequency;
+    dst.GotFreqency = src.GotFreqency;
+  }
+  if (groups & GROUP_CHANNEL) {
+    dst.Channel = src.Channel;
+    dst.GotChannel = src.GotChannel;
+  }
+}
+
+// Clears the bytes after the terminator, so that the parallel parse
+// yields the same Info byte for byte as the serial one
+
+template <size_t N>
+void zeroTail(char (&s)[N]) {
+  size_t len = strlen(s);
+  memset(s + len, 0, N - len);
+}
+
+// Returns the groups written
+
+unsigned parseLine(char *line, Info &info) {
+  size_t pos;
+
+  if ((pos = find(line, " ProcAtZrssiRes ")) != NPOS) {
+    const char *s = line + pos + strlen(" ProcAtZrssiRes ");
+
+    if (sscanf(s, "network_type = %63[^,], ", info.NetworkType) == 1) {
+      zeroTail(info.NetworkType);
+      info.GotNetworkType = true;
+      return GROUP_NETWORK_TYPE;
+    }
+  } else if ((pos = find(line, "AT+ZPAS?^M^M +ZPAS: ")) != NPOS) {
+    const char *s = line + pos + strlen("AT+ZPAS?^M^M +ZPAS: \"");
+    const char *p = strchr(s, '"');
+
+    if (p) {
+      size_t len = p - s;
+
+      if (len >= sizeof(info.NetworkType))
+        len = sizeof(info.NetworkType) - 1;
+
+      memcpy(info.NetworkType, s, len);
+      info.NetworkType[len] = '\0';
+      zeroTail(info.NetworkType);
+      info.GotNetworkType = true;
+      return GROUP_NETWORK_TYPE;
+    }
+  } else if ((pos = find(line, " +ZRSSI: ")) != NPOS) {
+    const char *s = line + pos + strlen(" +ZRSSI: ");
+    int RSRP, RSCP, RSRQ, RSSI;
+    float SINR, ECIO;
+
+    RSRP = RSCP = RSRQ = RSSI = 0xffff;
+    SINR = ECIO = -NAN;
+
+    int N = sscanf(s, "%d,%d,%d,%f", &RSRP, &RSRQ, &RSSI, &SINR);
+
+    if (N >= 1) {
+      if (N == 1) { // 2G
+        std::swap(RSRP, RSSI);
+      } else if (N == 2) { // 3G
+        N = (sscanf(s, "%d,%f", &RSCP, &ECIO) == 2);
+      } else { // 4G
+#if 0
+        if (RSSI < -113)
+          info.CSQ = 0.f;
+        else if (RSSI >= -51)
+          info.CSQ = 31.f;
+        else
+          info.CSQ = (113 - (RSSI * -1)) / 2.f;
+#endif
+      }
+
+      info.RSRP = RSRP; info.RSCP = RSCP;
+      info.RSRQ = RSRQ; info.RSSI = RSSI;
+      info.SINR = SINR; info.ECIO = ECIO;
+      info.GotSignalStrength = (N > 0);
+      return GROUP_SIGNAL;
+    }
+  } else if ((pos = find(line, " +CSQ: ")) != NPOS) {
+    for (char *c = line; *c; ++c) if (*c == ',') *c = '.';
+    const char *s = line + pos + strlen(" +CSQ: ");
+
+    if (sscanf(s, "%f", &info.CSQ) == 1) {
+      info.GotCSQ = true;
+      return GROUP_CSQ;
+    }
+  } else if ((pos = find(line, "LAC=")) != NPOS) {
+    const char *s = line + pos;
+    unsigned groups = 0;
+
+    if (sscanf(s, "LAC=%x", &info.LAC) == 1) {
+      info.GotLAC = true;
+      groups |= GROUP_LAC;
+    }
+
+    if ((pos = find(line, "CELL_ID=")) != NPOS) {
+      const char *s = line + pos;
+
+      if (sscanf(s, "CELL_ID=%x", &info.GlobalCellID) == 1) {
+        info.GotCellID = true;
+        groups |= GROUP_CELL_ID;
+      }
+    }
+
+    return groups;
+  } else if ((pos = find(line, " +ZDON: ")) != NPOS) {
+    const char *s = line + pos + strlen(" +ZDON: ");
+    unsigned groups = 0;
+
+    if (*s++ == '"') {
+      const char *p = strchr(s, '"');
+
+      if (p) {
+        while (*s == ' ')
+          ++s;
+
+        size_t len = p - s;
+
+        if (len >= sizeof(info.ProviderDesc))
+          len = sizeof(info.ProviderDesc) - 1;
+
+        memcpy(info.ProviderDesc, s, len);
+        info.ProviderDesc[len] = '\0';
+        zeroTail(info.ProviderDesc);
+        groups |= GROUP_PROVIDER_DESC;
+
+        if (*++p == ',') {
+          int MCC, MNC;
+
+          if(sscanf(p, ",%d,%d", &MCC, &MNC) == 2) {
+            char tmp[64];
+            snprintf(tmp, sizeof(tmp), "%d%02d", MCC, MNC);
+            info.MCCMNC = atoi(tmp);
+            info.GotProviderInfo = true;
+            groups |= GROUP_PROVIDER_ID;
+          }
+        }
+      }
+    }
+
+    return groups;
+  } else if ((pos = find(line, " +ZCELLINFO: ")) != NPOS) {
+    const char *s = line + pos + strlen(" +ZCELLINFO: ");
+    char rat[64];
+    int cellID, frequency, channel;
+    ChannelInfo channelInfo;
+
+    // 0: Global Cell ID, 1: Physical Cell ID, 2: Band, 3: Channel
+
+    if (sscanf(s, "%d, %*d, LTE %63[^,], %d", &cellID, rat, &channel) == 3) {
+      // The band alone gives the frequency, even for channels missing
+      // from the table
+      int MHz = rat[0] == 'B' ? getLTENominalMHz(atoi(rat + 1)) : 0;
+
+      info.Frequency = MHz ? MHz : -1;
+
+      info.GlobalCellID = cellID;
+      info.Channel = channel;
+      info.GotCellID = true;
+      info.GotFreqency = true;
+      info.GotChannel = true;
+      return GROUP_CELL_ID | GROUP_FREQUENCY | GROUP_CHANNEL;
+    }
+
+    // 2G/3G: "<RAT> <MHz>[, <ARFCN/UARFCN>]"
+
+    int N = sscanf(s, "%*d, %*d, %63s %d, %d", rat, &frequency, &channel);
+
+    if (N >= 2) {
+      auto r = RadioAccessTechnology(getNetworkTypeInfo(classifyNetworkType(rat)).RAT);
+
+      if (N == 3 && getChannelInfo(r, channel, channelInfo)) {
+        info.Frequency = channelInfo.NominalMHz;
+        info.GotFreqency = true;
+        info.Channel = channel;
+        info.GotChannel = true;
+        return GROUP_FREQUENCY | GROUP_CHANNEL;
+      }
+
+      info.Frequency = frequency;
+      info.GotFreqency = true;
+      return GROUP_FREQUENCY;
+    }
+  }
+
+  return 0;
+}
+
+void parseMessagesForward(const char *m, const char *end, Info &info, ParseState &state) {
+  char line[4096];
+
+  while (getLine(m, end, line)) {
+    unsigned groups = parseLine(line, info);
+
+    if (groups & GROUP_SIGNAL)
+      state.routerTime = parseSyslogTime(line, state.date);
+
+    if (groups & GROUP_NETWORK_TYPE)
+      state.networkTypeTime = parseSyslogTime(line, state.date);
+  }
+}
+
+// Walks the log from the end, the most recent line of a group wins.
+// Stops once every group has been seen, so the result is the one of the
+// forward parse: a group written by an older line than the others (e.g.
+// LAC= before +ZCELLINFO) is still found. Groups that were not found keep
+// the values of the previous poll.
+
+void parseMessagesReverse(const char *m, const char *end, Info &info, ParseState &state) {
+  char line[4096];
+  unsigned claimed = 0;
+  Info tmp;
+
+  while (claimed != ALL_GROUPS && getLineReverse(m, end, line)) {
+    unsigned groups = parseLine(line, tmp) & ~claimed;
+    copyGroups(tmp, info, groups);
+    claimed |= groups;
+
+    if (groups & GROUP_SIGNAL)
+      state.routerTime = parseSyslogTime(line, state.date);
+
+    if (groups & GROUP_NETWORK_TYPE)
+      state.networkTypeTime = parseSyslogTime(line, state.date);
+  }
+}
+
+// Parallel forward parse, see OPT_PARSE_THREADS.
+//
+// The syslog is split into chunks at line boundaries. Each chunk is parsed
+// into an Info of its own, remembering the groups it wrote. Merging the
+// chunks in order then gives the last writer of every group, exactly as
+// the serial parse does.
+//
+// The workers only keep the timestamp text of the lines, they are
+// converted by the merge. mktime() and localtime_r() are not reentrant in
+// every C library, and once per parse is enough.
+
+const size_t MIN_CHUNK_SIZE = 256 * 1024;
+const size_t SYSLOG_STAMP_SIZE = 16; // "Jan  1 00:01:23"
+
+struct ParseChunk {
+  const char *begin;
+  const char *end;
+  Info info;
+  unsigned groups;
+  char routerStamp[SYSLOG_STAMP_SIZE];
+  char networkTypeStamp[SYSLOG_STAMP_SIZE];
+};
+
+void copyStamp(char (&stamp)[SYSLOG_STAMP_SIZE], const char *line) {
+  size_t length = 0;
+
+  while (length < SYSLOG_STAMP_SIZE - 1 && line[length])
+    ++length;
+
+  memcpy(stamp, line, length);
+  stamp[length] = '\0';
+}
+
+void parseChunk(ParseChunk &chunk) {
+  const char *m = chunk.begin;
+  char line[4096];
+
+  chunk.groups = 0;
+
+  while (getLine(m, chunk.end, line)) {
+    unsigned groups = parseLine(line, chunk.info);
+
+    if (groups & GROUP_SIGNAL)
+      copyStamp(chunk.routerStamp, line);
+
+    if (groups & GROUP_NETWORK_TYPE)
+      copyStamp(chunk.networkTypeStamp, line);
+
+    chunk.groups |= groups;
+  }
+}
+
+class ParsePool {
+public:
+  ~ParsePool() { stop(); }
+
+  // Returns false if the syslog is too small to be worth splitting
+  bool parse(const char *begin, const char *end, Info &info, ParseState &state,
+             unsigned threads) {
+    size_t count = std::min<size_t>(threads, (end - begin) / MIN_CHUNK_SIZE);
+
+    if (count < 2)
+      return false;
+
+    if (workers.size() != threads - 1) {
+      stop();
+      chunks.resize(threads);
+
+      for (unsigned i = 0; i < threads - 1; ++i)
+        workers.emplace_back(&ParsePool::worker, this, generation);
+    }
+
+    const char *p = begin;
+
+    for (size_t i = 0; i < count; ++i) {
+      const char *chunkEnd = end;
+
+      // Split behind the first line break after the even share
+      if (i < count - 1) {
+        const char *split = std::max(p, begin + (end - begin) * (i + 1) / count);
+        const char *nl = (const char *)memchr(split, '\n', end - split);
+        chunkEnd = nl ? nl + 1 : end;
+      }
+
+      chunks[i].begin = p;
+      chunks[i].end = chunkEnd;
+      p = chunkEnd;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      chunkCount = count;
+      nextChunk = 0;
+      finished = 0;
+      idle = 0;
+      ++generation;
+    }
+
+    wakeUp.notify_all();
+    run();
+
+    {
+      // Every worker has to be done with this generation before the
+      // chunks can be reused
+      std::unique_lock<std::mutex> lock(mutex);
+      done.wait(lock, [&] { return finished == chunkCount && idle == workers.size(); });
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+      copyGroups(chunks[i].info, info, chunks[i].groups);
+
+      if (chunks[i].groups & GROUP_SIGNAL)
+        state.routerTime = parseSyslogTime(chunks[i].routerStamp, state.date);
+
+      if (chunks[i].groups & GROUP_NETWORK_TYPE)
+        state.networkTypeTime = parseSyslogTime(chunks[i].networkTypeStamp, state.date);
+    }
+
+    return true;
+  }
+
+  void stop() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+
+    wakeUp.notify_all();
+
+    for (std::thread &worker : workers)
+      worker.join();
+
+    workers.clear();
+    stopping = false;
+  }
+
+private:
+  void run() {
+    size_t i;
+
+    while ((i = nextChunk++) < chunkCount) {
+      parseChunk(chunks[i]);
+
+      std::lock_guard<std::mutex> lock(mutex);
+
+      if (++finished == chunkCount)
+        done.notify_one();
+    }
+  }
+
+  void worker(uint64_t seen) {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    for (;;) {
+      wakeUp.wait(lock, [&] { return stopping || generation != seen; });
+
+      if (stopping)
+        return;
+
+      seen = generation;
+      lock.unlock();
+      run();
+      lock.lock();
+
+      if (++idle == workers.size())
+        done.notify_one();
+    }
+  }
+
+  std::vector<std::thread> workers;
+  std::vector<ParseChunk> chunks;
+  std::mutex mutex;
+  std::condition_variable wakeUp;
+  std::condition_variable done;
+  std::atomic<size_t> nextChunk;
+  size_t chunkCount = 0;
+  size_t finished = 0;
+  size_t idle = 0;
+  uint64_t generation = 0;
+  bool stopping = false;
+};
+
+ParsePool parsePool;
+
+void parseMessages(const std::string &messages, Info &info, ParseState &state) {
+  const char *begin = messages.data();
+  const char *end = begin + messages.length();
+
+  if (parseMode == PARSE_REVERSE)
+    parseMessagesReverse(begin, end, info, state);
+  else if (parseThreads < 2 || !parsePool.parse(begin, end, info, state, parseThreads))
+    parseMessagesForward(begin, end, info, state);
+}
+
+// JSON status API, see DATA_SOURCE_STATUS.
+// The field names are the ones used by the router's web interface.
+
+const char STATUS_REQUEST[] =
+    "/goform/goform_get_cmd_process?isTest=false&multi_data=1&cmd="
+    "network_type,network_provider,rmcc,rmnc,lte_rsrp,lte_rsrq,lte_rssi,lte_snr,"
+    "rssi,rscp,ecio,cell_id,lac_code,lte_band,wan_active_channel";
+
+struct StatusFields {
+  JSONToken NetworkType, Provider, MCC, MNC;
+  JSONToken RSRP, RSRQ, LTERSSI, SINR, RSSI, RSCP, ECIO;
+  JSONToken CellID, LAC, Band, Channel;
+};
+
+const struct {
+  const char *Key;
+  JSONToken StatusFields::*Field;
+} statusKeys[] = {
+  { "network_type",       &StatusFields::NetworkType },
+  { "network_provider",   &StatusFields::Provider },
+  { "rmcc",               &StatusFields::MCC },
+  { "rmnc",               &StatusFields::MNC },
+  { "lte_rsrp",           &StatusFields::RSRP },
+  { "lte_rsrq",           &StatusFields::RSRQ },
+  { "lte_rssi",           &StatusFields::LTERSSI },
+  { "lte_snr",            &StatusFields::SINR },
+  { "rssi",               &StatusFields::RSSI },
+  { "rscp",               &StatusFields::RSCP },
+  { "ecio",               &StatusFields::ECIO },
+  { "cell_id",            &StatusFields::CellID },
+  { "lac_code",           &StatusFields::LAC },
+  { "lte_band",           &StatusFields::Band },
+  { "wan_active_channel", &StatusFields::Channel },
+};
+
+// The values are quoted, but the JSON buffer is '\0'-terminated, so
+// strtol() / strtof() stop at the closing quote at the latest
+
+bool toInt(const JSONToken &token, int &v, int base = 10) {
+  char *end;
+
+  if (!token.Length)
+    return false;
+
+  v = int(strtol(token.Data, &end, base));
+  return end != token.Data && end <= token.Data + token.Length;
+}
+
+bool toFloat(const JSONToken &token, float &v) {
+  char *end;
+
+  if (!token.Length)
+    return false;
+
+  v = strtof(token.Data, &end);
+  return end != token.Data && end <= token.Data + token.Length;
+}
+
+void parseStatus(const std::string &status, Info &info, ParseState &state) {
+  JSONScanner json(status.c_str(), status.length());
+  JSONToken key, value;
+  StatusFields fields = {};
+
+  if (!json.begin())
+    return;
+
+  while (json.next(key, value)) {
+    for (const auto &statusKey : statusKeys) {
+      if (key.equals(statusKey.Key)) {
+        fields.*statusKey.Field = value;
+        break;
+      }
+    }
+  }
+
+  if (fields.NetworkType.Length) {
+    fields.NetworkType.copyTo(info.NetworkType);
+    info.GotNetworkType = true;
+  }
+
+  auto rat = getNetworkTypeInfo(classifyNetworkType(info.NetworkType)).RAT;
+  int RSRP, RSCP, RSRQ, RSSI, v;
+  float SINR, ECIO;
+  bool gotSignalStrength = false;
+
+  RSRP = RSCP = RSRQ = RSSI = 0xffff;
+  SINR = ECIO = -NAN;
+
+  switch (rat) {
+    case RAT_EUTRAN:
+      gotSignalStrength = toInt(fields.RSRP, RSRP);
+      toInt(fields.RSRQ, RSRQ);
+      toFloat(fields.SINR, SINR);
+      if (!toInt(fields.LTERSSI, RSSI))
+        toInt(fields.RSSI, RSSI);
+      break;
+    case RAT_UTRAN:
+      gotSignalStrength = toInt(fields.RSCP, RSCP) && toFloat(fields.ECIO, ECIO);
+      toInt(fields.RSSI, RSSI);
+      break;
+    case RAT_GERAN:
+      gotSignalStrength = toInt(fields.RSSI, RSSI);
+      break;
+  }
+
+  if (gotSignalStrength) {
+    info.RSRP = RSRP; info.RSCP = RSCP;
+    info.RSRQ = RSRQ; info.RSSI = RSSI;
+    info.SINR = SINR; info.ECIO = ECIO;
+    info.GotSignalStrength = true;
+
+    // No +CSQ here, derive it from the RSSI in dBm
+    if (RSSI != 0xffff) {
+      info.CSQ = std::min(std::max((RSSI + 113) / 2.f, 0.f), 31.f);
+      info.GotCSQ = true;
+    }
+  }
+
+  if (toInt(fields.CellID, v, 16)) {
+    info.GlobalCellID = v;
+    info.GotCellID = true;
+  }
+
+  if (toInt(fields.LAC, v, 16)) {
+    info.LAC = v;
+    info.GotLAC = true;
+  }
+
+  if (fields.Provider.Length)
+    fields.Provider.copyTo(info.ProviderDesc);
+
+  int MCC, MNC;
+
+  if (toInt(fields.MCC, MCC) && toInt(fields.MNC, MNC)) {
+    char tmp[64];
+    snprintf(tmp, sizeof(tmp), "%d%02d", MCC, MNC);
+    info.MCCMNC = atoi(tmp);
+    info.GotProviderInfo = true;
+  }
+
+  int channel;
+  ChannelInfo channelInfo;
+
+  if (toInt(fields.Channel, channel)) {
+    JSONToken band = fields.Band;
+
+    if (band.Length && band.Data[0] == 'B')
+      ++band.Data, --band.Length;
+
+    int MHz = 0;
+
+    // As with +ZCELLINFO, the LTE band alone gives the frequency
+    if (rat == RAT_EUTRAN) {
+      if (toInt(band, v))
+        MHz = getLTENominalMHz(v);
+    } else if (getChannelInfo(RadioAccessTechnology(rat), channel, channelInfo)) {
+      MHz = channelInfo.NominalMHz;
+    }
+
+    info.Frequency = MHz ? MHz : -1;
+    info.Channel = channel;
+    info.GotFreqency = true;
+    info.GotChannel = true;
+  }
+
+  state.routerTime = 0; // The status API has no measurement time
+}
+
+// Conditional fetch of the syslog, see OPT_CONDITIONAL_FETCH.
+//
+// The validators of the last full response are compared to the ones of a
+// HEAD request if the router sends an ETag or Last-Modified header, and to
+// the total length and last TAIL_BYTES bytes of a Range request otherwise.
+
+enum FetchResult {
+  FETCH_FAILED,
+  FETCH_OK,
+  FETCH_UNCHANGED
+};
+
+uint64_t hashBytes(const char *s, size_t length) {
+  uint64_t h = 14695981039346656037ULL;
+
+  while (length--)
+    h = (h ^ (unsigned char)*s++) * 1099511628211ULL;
+
+  return h;
+}
+
+uint64_t hashTail(const std::string &body) {
+  size_t length = std::min<size_t>(body.length(), TAIL_BYTES);
+  return hashBytes(body.data() + body.length() - length, length);
+}
+
+struct {
+  RequestKind probe = REQUEST_FULL; // REQUEST_FULL: not determined yet
+  bool valid = false;
+  Response last;
+  uint64_t lastTailHash;
+  std::string tail;
+
+  void reset() {
+    probe = REQUEST_FULL;
+    valid = false;
+  }
+
+  void remember(const std::string &body, const Response &response) {
+    last = response;
+    last.ContentLength = body.length();
+    lastTailHash = hashTail(body);
+    valid = true;
+  }
+} conditionalState;
+
+FetchResult fetchMessagesConditional(std::string &data) {
+  auto &state = conditionalState;
+  Response response;
+
+  if (state.valid && state.probe != REQUEST_TAIL) {
+    if (!httpRequest("/messages", data, nullptr, &response, REQUEST_HEAD))
+      return FETCH_FAILED;
+
+    if (response.Status == 200 && (response.ETag[0] || response.LastModified[0])) {
+      state.probe = REQUEST_HEAD;
+
+      if (response.ContentLength == state.last.ContentLength &&
+          !strcmp(response.ETag, state.last.ETag) &&
+          !strcmp(response.LastModified, state.last.LastModified))
+        return FETCH_UNCHANGED;
+    } else {
+      state.probe = REQUEST_TAIL;
+    }
+  }
+
+  if (state.valid && state.probe == REQUEST_TAIL) {
+    if (!httpRequest("/messages", state.tail, nullptr, &response, REQUEST_TAIL))
+      return FETCH_FAILED;
+
+    if (response.Status == 206) {
+      if (response.TotalLength == state.last.ContentLength &&
+          hashTail(state.tail) == state.lastTailHash)
+        return FETCH_UNCHANGED;
+    } else if (response.Status == 200) {
+      // Range is not supported, this is the whole body
+      std::swap(data, state.tail);
+      state.remember(data, response);
+      return FETCH_OK;
+    }
+  }
+
+  if (!httpRequest("/messages", data, nullptr, &response))
+    return FETCH_FAILED;
+
+  state.remember(data, response);
+  return FETCH_OK;
+}
+
+// Data sources, see OPT_DATA_SOURCE
+
+struct DataSourceImpl {
+  const char *path; // of the responses carrying the data, without query
+  FetchResult (*fetch)(std::string &data);
+  void (*parse)(const std::string &data, Info &info, ParseState &state);
+};
+
+const DataSourceImpl dataSources[] = {
+  {
+    "/messages",
+    [](std::string &data) {
+      if (!httpRequest("/goform/goform_set_cmd_process",
+                       data,
+                       "isTest=false&goformId=SYSLOG&syslog_flag=open&syslog_mode=wan_connect"))
+        return FETCH_FAILED;
+
+      if (conditionalFetch)
+        return fetchMessagesConditional(data);
+
+      return httpRequest("/messages", data) ? FETCH_OK : FETCH_FAILED;
+    },
+    parseMessages
+  },
+  {
+    "/goform/goform_get_cmd_process",
+    [](std::string &data) {
+      return httpRequest(STATUS_REQUEST, data) ? FETCH_OK : FETCH_FAILED;
+    },
+    parseStatus
+  }
+};
+
+const DataSourceImpl *findDataSource(const char *request) {
+  size_t len = strcspn(request, "?");
+
+  for (const DataSourceImpl &source : dataSources) {
+    if (!strncmp(request, source.path, len) && source.path[len] == '\0')
+      return &source;
+  }
+
+  return nullptr;
+}
+
+// Returns false if the values got reset. LastUpdate and N are left to
+// processData(), which only counts changes.
+bool parseData(const DataSourceImpl &source, const std::string &data, Info &info,
+               ParseState &state) {
+  int prevGeneration = -1;
+
+  if (info.GotNetworkType)
+    prevGeneration = getNetworkTypeInfo(state.networkType).Generation;
+
+  source.parse(data, info, state);
+
+  if (info.GotNetworkType)
+    state.networkType = classifyNetworkType(info.NetworkType);
+
+  int generation = getNetworkTypeInfo(state.networkType).Generation;
+  bool switched = prevGeneration != -1 && info.GotNetworkType && prevGeneration != generation;
+
+  // Signal values logged before the current network type line still belong
+  // to the previous RAT. Sources without syslog times are always current.
+  bool fresh = !state.routerTime || !state.networkTypeTime ||
+               state.routerTime >= state.networkTypeTime;
+
+  RATCacheEntry &cached = state.ratCache[generation];
+
+  if ((switched || state.stale) && !fresh && cached.valid) {
+    // Keep showing the last known values of this RAT until it has logged
+    // new ones
+    copyGroups(cached.info, info, CACHED_GROUPS);
+    state.routerTime = cached.routerTime;
+    state.stale = true;
+  } else if (switched && !fresh) {
+    info.reset(); // Force clean values after net switch
+    state.resetNetwork();
+    return false;
+  } else {
+    state.stale = false;
+
+    if (info.GotNetworkType && info.GotSignalStrength && info.GotCSQ) {
+      cached.info = info;
+      cached.routerTime = state.routerTime;
+      cached.valid = true;
+    }
+  }
+
+  return true;
+}
+
+uint64_t hashLine(const char *s) {
+  return hashBytes(s, strlen(s));
+}
+
+// Every +ZRSSI / +CSQ measurement of the syslog, see OPT_BACKFILL.
+
+const size_t HISTORY_SIZE = 4096;
+
+Sample history[HISTORY_SIZE];
+uint64_t historyEnd;
+std::mutex historyMutex;
+
+SampleCallback sampleCallback;
+void *sampleCallbackData;
+
+// Bound of the measurements in one response, every line of a full response
+// buffer being the shortest one, "Jan 1 00:00:00 +CSQ: 9\n". Both vectors of
+// backfillState are reserved to it, so bursts after the router was
+// unreachable for a while do not reallocate either.
+const size_t MIN_SAMPLE_LINE = 23;
+const size_t BACKFILL_CAPACITY = RESPONSE_CAPACITY / MIN_SAMPLE_LINE;
+
+struct {
+  int64_t lastTime = 0;
+  std::vector<uint64_t> lastHashes; // lines ingested at lastTime
+  NetworkTypeID networkType = NETWORK_TYPE_UNKNOWN;
+  std::vector<Sample> batch;
+  SyslogDate date;
+} backfillState;
+
+bool isNewSample(int64_t time, uint64_t hash) {
+  auto &state = backfillState;
+
+  if (time < state.lastTime)
+    return false;
+
+  if (time == state.lastTime &&
+      std::find(state.lastHashes.begin(), state.lastHashes.end(), hash) != state.lastHashes.end())
+    return false;
+
+  if (time > state.lastTime) {
+    state.lastTime = time;
+    state.lastHashes.clear();
+  }
+
+  state.lastHashes.push_back(hash);
+  return true;
+}
+
+void backfillSamples(const std::string &messages) {
+  auto &state = backfillState;
+  const char *begin = messages.data();
+  const char *end = begin + messages.length();
+  const char *m = end;
+  char line[4096];
+
+  // No-ops after the first call
+  state.lastHashes.reserve(BACKFILL_CAPACITY);
+  state.batch.reserve(BACKFILL_CAPACITY);
+
+  // Find the first line that has not been ingested yet
+
+  while (getLineReverse(begin, m, line)) {
+    int64_t time = parseSyslogTime(line, state.date);
+
+    if (time && time < state.lastTime) {
+      getLine(m, end, line);
+      break;
+    }
+  }
+
+  Info tmp;
+  state.batch.clear();
+
+  while (getLine(m, end, line)) {
+    int64_t time = parseSyslogTime(line, state.date);
+    uint64_t hash = hashLine(line);
+    unsigned groups = parseLine(line, tmp);
+
+    if (groups & GROUP_NETWORK_TYPE)
+      state.networkType = classifyNetworkType(tmp.NetworkType);
+
+    if (!(groups & (GROUP_SIGNAL | GROUP_CSQ)) || !time || !isNewSample(time, hash))
+      continue;
+
+    Sample sample;
+
+    sample.RouterTime = time;
+    sample.Kind = (groups & GROUP_SIGNAL) ? SAMPLE_SIGNAL : SAMPLE_CSQ;
+    sample.NetworkType = uint8_t(state.networkType);
+    sample.RSRP = toInt16(tmp.RSRP);
+    sample.RSCP = toInt16(tmp.RSCP);
+    sample.RSRQ = toInt16(tmp.RSRQ);
+    sample.RSSI = toInt16(tmp.RSSI);
+    sample.SINR = tmp.SINR;
+    sample.ECIO = tmp.ECIO;
+    sample.CSQ = tmp.CSQ;
+    state.batch.push_back(sample);
+  }
+
+  if (state.batch.empty())
+    return;
+
+  historyMutex.lock();
+  for (const Sample &sample : state.batch)
+    history[historyEnd++ % HISTORY_SIZE] = sample;
+  SampleCallback callback = sampleCallback;
+  void *callbackData = sampleCallbackData;
+  historyMutex.unlock();
+
+  if (callback)
+    callback(state.batch.data(), state.batch.size(), callbackData);
+}
+
+Timestamp Timestamp::now() {
+  return { getMonotonicTime(), wallClockNs() };
+}
+
+// Delta snapshots, see getChanges(). Every publish bumps snapshotVersion,
+// changeVersions tells the version of the last change of each field.
+// Guarded by mutex.
+
+enum DeltaKind {
+  DELTA_UNSIGNED, // LEB128
+  DELTA_SIGNED,   // zigzag LEB128
+  DELTA_FLOAT     // 4 bytes, little endian
+};
+
+struct DeltaField {
+  uint32_t change; // InfoChange
+  size_t offset;
+  size_t size;
+  DeltaKind kind;
+};
+
+#define DELTA_FIELD(CHANGE, MEMBER, KIND) \
+  { CHANGE, offsetof(InfoV2, MEMBER), sizeof(InfoV2::MEMBER), KIND }
+
+// In encoding order, a change bit may cover several members
+const DeltaField deltaFields[] = {
+  DELTA_FIELD(CHANGE_PRESENT, Present, DELTA_UNSIGNED),
+  DELTA_FIELD(CHANGE_LAST_UPDATE, LastUpdate, DELTA_SIGNED),
+  DELTA_FIELD(CHANGE_NETWORK_TYPE, NetworkType, DELTA_UNSIGNED),
+  DELTA_FIELD(CHANGE_PROVIDER, ProviderID, DELTA_UNSIGNED),
+  DELTA_FIELD(CHANGE_PROVIDER, MCCMNC, DELTA_SIGNED),
+  DELTA_FIELD(CHANGE_RSRP, RSRP, DELTA_SIGNED),
+  DELTA_FIELD(CHANGE_RSCP, RSCP, DELTA_SIGNED),
+  DELTA_FIELD(CHANGE_RSRQ, RSRQ, DELTA_SIGNED),
+  DELTA_FIELD(CHANGE_RSSI, RSSI, DELTA_SIGNED),
+  DELTA_FIELD(CHANGE_SINR, SINR, DELTA_FLOAT),
+  DELTA_FIELD(CHANGE_ECIO, ECIO, DELTA_FLOAT),
+  DELTA_FIELD(CHANGE_CSQ, CSQ, DELTA_FLOAT),
+  DELTA_FIELD(CHANGE_LAC, LAC, DELTA_SIGNED),
+  DELTA_FIELD(CHANGE_CELL_ID, GlobalCellID, DELTA_SIGNED),
+  DELTA_FIELD(CHANGE_FREQUENCY, Frequency, DELTA_SIGNED),
+  DELTA_FIELD(CHANGE_CHANNEL, Channel, DELTA_SIGNED),
+  DELTA_FIELD(CHANGE_BAND, Band, DELTA_UNSIGNED),
+  DELTA_FIELD(CHANGE_BAND, DLFrequency, DELTA_SIGNED),
+  DELTA_FIELD(CHANGE_BAND, ULFrequency, DELTA_SIGNED),
+  DELTA_FIELD(CHANGE_ROUTER_TIME, RouterTime, DELTA_SIGNED)
+};
+
+const int CHANGE_COUNT = 17;
+static_assert(CHANGE_ROUTER_TIME == 1 << (CHANGE_COUNT - 1), "CHANGE_COUNT is out of date");
+
+// Change on every poll, do not make a snapshot new on their own
+const uint32_t HEARTBEAT_CHANGES = CHANGE_LAST_UPDATE | CHANGE_ROUTER_TIME;
+
+uint64_t snapshotVersion;
+uint64_t changeVersions[CHANGE_COUNT];
+InfoV2 lastPublished;
+Heartbeat heartbeat;
+
+uint64_t loadUnsigned(const void *p, size_t size) {
+  switch (size) {
+    case 1: { uint8_t v; memcpy(&v, p, 1); return v; }
+    case 2: { uint16_t v; memcpy(&v, p, 2); return v; }
+    case 4: { uint32_t v; memcpy(&v, p, 4); return v; }
+  }
+  uint64_t v;
+  memcpy(&v, p, 8);
+  return v;
+}
+
+int64_t loadSigned(const void *p, size_t size) {
+  switch (size) {
+    case 1: { int8_t v; memcpy(&v, p, 1); return v; }
+    case 2: { int16_t v; memcpy(&v, p, 2); return v; }
+    case 4: { int32_t v; memcpy(&v, p, 4); return v; }
+  }
+  int64_t v;
+  memcpy(&v, p, 8);
+  return v;
+}
+
+// Truncates, which also stores signed values in two's complement
+void storeValue(void *p, size_t size, uint64_t v) {
+  switch (size) {
+    case 1: { uint8_t x = uint8_t(v); memcpy(p, &x, 1); return; }
+    case 2: { uint16_t x = uint16_t(v); memcpy(p, &x, 2); return; }
+    case 4: { uint32_t x = uint32_t(v); memcpy(p, &x, 4); return; }
+  }
+  memcpy(p, &v, 8);
+}
+
+void markAllChanged() {
+  ++snapshotVersion;
+
+  for (uint64_t &version : changeVersions)
+    version = snapshotVersion;
+}
+
+// Compares the bytes, so NaN values (SINR, ECIO) compare equal
+uint32_t compareInfo(const InfoV2 &a, const InfoV2 &b) {
+  uint32_t changes = 0;
+
+  for (const DeltaField &field : deltaFields) {
+    if (memcmp((const char *)&a + field.offset, (const char *)&b + field.offset, field.size))
+      changes |= field.change;
+  }
+
+  return changes;
+}
+
+uint32_t recordChanges(const InfoV2 &info) {
+  uint32_t changes = compareInfo(info, lastPublished);
+
+  ++snapshotVersion;
+
+  for (int i = 0; i < CHANGE_COUNT; ++i) {
+    if (changes & (1u << i))
+      changeVersions[i] = snapshotVersion;
+  }
+
+  lastPublished = info;
+  return changes;
+}
+
+// Called with mutex held. The legacy Info::LastUpdate follows every
+// heartbeat, as it did before snapshots were only published on change.
+void recordHeartbeat(const Timestamp &time) {
+  ++heartbeat.Count;
+  heartbeat.LastMono = time.mono;
+  heartbeat.LastWall = time.wall;
+  info.LastUpdate = time_t(time.wall / 1000000000);
+}
+
+void processData(const DataSourceImpl &source, const std::string &data,
+                 const Timestamp &fetchStart, const Timestamp &fetchEnd) {
+  auto start = std::chrono::steady_clock::now();
+  mutex.lock();
+  bool parsed = parseData(source, data, info, parseState);
+  InfoV2 next;
+  convertInfo(info, next);
+  Timestamp publish = Timestamp::now();
+  next.FetchStartMono = fetchStart.mono;
+  next.FetchEndMono = fetchEnd.mono;
+  next.PublishMono = publish.mono;
+  next.FetchStartWall = fetchStart.wall;
+  next.FetchEndWall = fetchEnd.wall;
+  next.PublishWall = publish.wall;
+  next.RouterTime = parseState.routerTime;
+
+  if (parseState.stale)
+    next.Present |= INFO_STALE;
+
+  // Unchanged samples only count as heartbeat, consumers are not woken up
+  bool published = parsed && (!infoV2.N || (compareInfo(next, infoV2) & ~HEARTBEAT_CHANGES));
+  uint32_t changes = 0;
+
+  if (published) {
+    info.LastUpdate = time_t(publish.wall / 1000000000);
+    info.N++;
+    next.LastUpdate = info.LastUpdate;
+    next.N = uint32_t(info.N);
+    changes = recordChanges(next);
+  }
+
+  if (published || !parsed)
+    infoV2 = next;
+
+  if (parsed)
+    recordHeartbeat(publish);
+
+  if (published && !firstSampleUs)
+    firstSampleUs = std::max<uint64_t>(uint64_t(publish.mono - initStartMono) / 1000, 1);
+
+  mutex.unlock();
+
+  if (published) {
+    signalEvent();
+    notify(NOTIFY_SAMPLE);
+  }
+
+  if (changes & CHANGE_NETWORK_TYPE)
+    notify(NOTIFY_NETWORK_CHANGE);
+
+  histograms[PHASE_PARSE].record(elapsedUs(start));
+
+  if (parsed) {
+    histograms[PHASE_POLL].record(uint64_t(publish.mono - fetchStart.mono) / 1000);
+
+    if (parseState.routerTime)
+      histograms[PHASE_DATA_AGE].record(
+          uint64_t(std::max<int64_t>(publish.wall - parseState.routerTime, 0)) / 1000);
+  }
+
+  if (backfill && &source == &dataSources[DATA_SOURCE_SYSLOG])
+    backfillSamples(data);
+}
+
+// See OPT_FIRST_SNAPSHOT. The login runs on a second connection while the
+// first sample is fetched. If the router did not serve the data before the
+// session existed, it is fetched once more after the login.
+
+int loginWithFirstSnapshot(std::string &data) {
+  const DataSourceImpl &source = dataSources[dataSource];
+  Connection loginConnection;
+  std::string loginData;
+  int rc = -1;
+
+  loginConnection.setConnectTimeout(mainConnection.connectTimeoutMs);
+
+  std::thread loginThread([&] { rc = login(loginData, loginConnection); });
+
+  Timestamp fetchStart = Timestamp::now();
+  FetchResult result = source.fetch(data);
+
+  loginThread.join();
+  loginConnection.close();
+
+  if (rc != 1)
+    return rc;
+
+  initState = INIT_STATE_FIRST_SAMPLE;
+
+  if (result != FETCH_OK || (data.length() > 0 && data[0] == '<')) {
+    conditionalState.reset();
+    fetchStart = Timestamp::now();
+    result = source.fetch(data);
+  }
+
+  if (result == FETCH_OK && !(data.length() > 0 && data[0] == '<'))
+    processData(source, data, fetchStart, Timestamp::now());
+
+  return rc;
+}
+
+// init() gives up on routers which do not accept a connection within
+// about a second, the timeouts of later requests are not affected
+
+const int INIT_CONNECT_TIMEOUT_MS = 300;
+const int INIT_CONNECT_ATTEMPTS = 3;
+const int CONNECT_TIMEOUT_MS = 30000;
+
+bool probeRouter() {
+#ifndef _WIN32
+  initState = INIT_STATE_RESOLVING;
+  addrinfo *addresses = HTTPClient::resolve(routerIP.c_str());
+
+  if (!addresses)
+    return false;
+
+  initState = INIT_STATE_CONNECTING;
+  bool connected = false;
+
+  for (int attempt = 0; attempt < INIT_CONNECT_ATTEMPTS && !connected; ++attempt)
+    connected = mainConnection.httpClient.open(addresses, INIT_CONNECT_TIMEOUT_MS);
+
+  freeaddrinfo(addresses);
+
+  // The built-in client reuses the connection for the login, curl opens
+  // its own
+  if (transport != TRANSPORT_BUILTIN)
+    mainConnection.close();
+
+  return connected;
+#else
+  return true; // curl's connect timeout is shortened instead
+#endif
+}
+
+// Router discovery, see discoverRouter(). Every candidate is probed on its
+// own thread, the first one answering the fingerprint request wins.
+
+const char FINGERPRINT_REQUEST[] = "/goform/goform_get_cmd_process?isTest=false&cmd=network_type";
+
+const char *const DISCOVERY_CANDIDATES[] = {
+  "192.168.0.1", "192.168.1.1", "192.168.2.1", "192.168.8.1", "ralink.ralinktech.com"
+};
+
+struct Discovery {
+  std::mutex mutex;
+  std::condition_variable done;
+  char IP[64] = "";
+  size_t pending;
+  std::atomic<bool> finished{false}; // the remaining probes may give up
+};
+
+// Probe threads still running. discoverRouter() does not wait for the
+// ones left after the first answer, deinit() does, so that none of them
+// outlives the library.
+std::mutex probeMutex;
+std::condition_variable probesDone;
+size_t runningProbes = 0;
+
+void waitForProbes() {
+  std::unique_lock<std::mutex> lock(probeMutex);
+  probesDone.wait(lock, [] { return !runningProbes; });
+}
+
+bool getDefaultGateway(char (&IP)[64]) {
+#ifdef __linux__
+  FILE *f = fopen("/proc/net/route", "r");
+  char line[256];
+  bool found = false;
+
+  if (!f)
+    return false;
+
+  while (!found && fgets(line, sizeof(line), f)) {
+    char interface[64];
+    unsigned destination, gateway, flags;
+
+    // Addresses are in network byte order, 0x2 is RTF_GATEWAY
+    if (sscanf(line, "%63s %x %x %x", interface, &destination, &gateway, &flags) == 4 &&
+        destination == 0 && (flags & 0x2)) {
+      in_addr address;
+      address.s_addr = gateway;
+      found = inet_ntop(AF_INET, &address, IP, sizeof(IP)) != nullptr;
+    }
+  }
+
+  fclose(f);
+  return found;
+#else
+  (void)IP;
+  return false;
+#endif
+}
+
+// Resolves host to IP and checks whether it answers like the router.
+// The probe gives up once cancel is set, within about a second with curl
+// and 100 ms with the built-in client.
+bool isRouter(const char *host, int timeoutMs, const std::atomic<bool> &cancel, char (&IP)[64]) {
+  std::string body;
+
+#ifndef _WIN32
+  addrinfo *addresses = HTTPClient::resolve(host);
+
+  if (!addresses)
+    return false;
+
+  bool numeric = !getnameinfo(addresses->ai_addr, addresses->ai_addrlen, IP, sizeof(IP),
+                              nullptr, 0, NI_NUMERICHOST);
+  freeaddrinfo(addresses);
+
+  if (!numeric)
+    return false;
+
+  HTTPClient client;
+  Response response;
+  RequestTimes times;
+
+  client.setConnectTimeout(timeoutMs);
+  client.setCancel(&cancel);
+
+  if (!client.request(IP, FINGERPRINT_REQUEST, nullptr, REQUEST_FULL, timeoutMs,
+                      body, response, times) ||
+      response.Status != 200)
+    return false;
+#else
+  CURL *handle = curl_easy_init();
+  std::string URL = std::string("http://") + host + FINGERPRINT_REQUEST;
+  long status = 0;
+
+  if (!handle)
+    return false;
+
+  auto callback = [](void *data, size_t size, size_t nmemb, std::string &buf) {
+    buf.append((const char *)data, size * nmemb);
+    return size * nmemb;
+  };
+
+  auto progress = [](void *cancel, curl_off_t, curl_off_t, curl_off_t, curl_off_t) {
+    return int(((const std::atomic<bool> *)cancel)->load());
+  };
+
+  curl_easy_setopt(handle, CURLOPT_URL, URL.c_str());
+  curl_easy_setopt(handle, CURLOPT_CONNECTTIMEOUT_MS, long(timeoutMs));
+  curl_easy_setopt(handle, CURLOPT_TIMEOUT_MS, long(timeoutMs));
+  curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, +callback);
+  curl_easy_setopt(handle, CURLOPT_WRITEDATA, &body);
+  curl_easy_setopt(handle, CURLOPT_XFERINFOFUNCTION, +progress);
+  curl_easy_setopt(handle, CURLOPT_XFERINFODATA, (void *)&cancel);
+  curl_easy_setopt(handle, CURLOPT_NOPROGRESS, 0L);
+  curl_easy_setopt(handle, CURLOPT_NOSIGNAL, 1L);
+
+  bool ok = curl_easy_perform(handle) == CURLE_OK &&
+            curl_easy_getinfo(handle, CURLINFO_RESPONSE_CODE, &status) == CURLE_OK &&
+            status == 200;
+  curl_easy_cleanup(handle);
+
+  if (!ok)
+    return false;
+
+  snprintf(IP, sizeof(IP), "%s", host);
+#endif
+
+  JSONScanner scanner(body.data(), body.length());
+  JSONToken key, value;
+
+  if (!scanner.begin())
+    return false;
+
+  while (scanner.next(key, value)) {
+    if (key.equals("network_type"))
+      return true;
+  }
+
+  return false;
+}
+
+bool isInitPending(InitState state) {
+  return state != INIT_STATE_IDLE && state != INIT_STATE_READY && state != INIT_STATE_FAILED;
+}
+
+// Sets the final state of init() and wakes the NOTIFY_INIT_DONE waiters.
+// Checked and set under notifyMutex, so that notifyOnce() cannot miss it.
+void finishInit(InitState state) {
+  {
+    std::lock_guard<std::mutex> lock(notifyMutex);
+    initState = state;
+  }
+
+  notify(NOTIFY_INIT_DONE);
+}
+
+void updateThread() {
+  const DataSourceImpl &source = dataSources[dataSource];
+  std::string data;
+#ifdef ALLOC_CHECK
+  int polls = 0;
+#endif
+
+  data.reserve(RESPONSE_CAPACITY);
+
+  do {
+    Timestamp fetchStart = Timestamp::now();
+
+    switch (source.fetch(data)) {
+      case FETCH_OK:
+        if (data.length() > 0 && data[0] == '<') {
+          conditionalState.reset();
+          login(data);
+        } else {
+          processData(source, data, fetchStart, Timestamp::now());
+        }
+        break;
+      case FETCH_UNCHANGED:
+        ++skippedPolls;
+        mutex.lock();
+        recordHeartbeat(Timestamp::now());
+        mutex.unlock();
+        break;
+      case FETCH_FAILED:
+        break;
+    }
+
+#ifdef ALLOC_CHECK
+    if (++polls == ALLOC_CHECK_WARMUP)
+      allocCheck = true;
+#endif
+
+    Sleep(updateInterval);
+  } while (!deinitRequest);
+
+#ifdef ALLOC_CHECK
+  allocCheck = false;
+#endif
+}
+
+void replayThread(FILE *f, double speed) {
+  std::string data;
+  char request[256];
+  int64_t time, prevTime = -1;
+  Timestamp fetchStart = Timestamp::now();
+
+  while (!deinitRequest && readRecord(f, time, request, data)) {
+    const DataSourceImpl *source = findDataSource(request);
+
+    if (!source || (!data.empty() && data[0] == '<'))
+      continue;
+
+    if (speed > 0.0 && prevTime != -1 && time > prevTime) {
+      auto delay = std::chrono::steady_clock::now() +
+                   std::chrono::nanoseconds(int64_t((time - prevTime) / speed));
+
+      while (!deinitRequest && std::chrono::steady_clock::now() < delay)
+        std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(
+            delay - std::chrono::steady_clock::now(), std::chrono::milliseconds(100)));
+    }
+
+    prevTime = time;
+    processData(*source, data, fetchStart, Timestamp::now());
+    fetchStart = Timestamp::now();
+  }
+
+  fclose(f);
+  replayFinished = true;
+}
+
+} // unnamed namespace
+
+InitCode init(const char *routerIP, const char *routerPW, int updateInterval) {
+#ifndef TEST
+  if (!transportInit())
+    abort();
+
+  char routerPWBase64[1024];
+
+  base64_encode(strlen(routerPW), (const unsigned char*)routerPW,
+                sizeof(routerPWBase64), routerPWBase64);
+
+  ::zte_mf283plus_watch::routerIP = routerIP;
+  ::zte_mf283plus_watch::updateInterval = updateInterval;
+  routerURL = std::string("http://") + routerIP;
+  refererURL = routerURL + "/index.html";
+  loginPOSTData = std::string("isTest=false&goformId=LOGIN&password=") + routerPWBase64;
+
+  info.reset();
+  infoV2 = InfoV2();
+  lastPublished = InfoV2();
+  heartbeat = Heartbeat();
+  markAllChanged();
+  parseState.reset();
+  conditionalState.reset();
+  initStartMono = getMonotonicTime();
+  firstSampleUs = 0;
+
+  std::string data;
+  int rc = -1;
+
+  mainConnection.setConnectTimeout(INIT_CONNECT_TIMEOUT_MS);
+
+  if (probeRouter()) {
+    initState = INIT_STATE_AUTHENTICATING;
+    rc = firstSnapshot ? loginWithFirstSnapshot(data) : login(data);
+  }
+
+  mainConnection.setConnectTimeout(CONNECT_TIMEOUT_MS);
+
+  if (rc != 1) {
+    transportCleanup();
+    finishInit(INIT_STATE_FAILED);
+  }
+
+  switch (rc) {
+    case -1: return INIT_ERR_HTTP_REQUEST_FAILED;
+    case -2: return INIT_ERR_NOT_A_ZTE_MF283P;
+    case -3: return INIT_ERR_WRONG_PASSWORD;
+  }
+#endif
+
+  updateThreadHandle = new std::thread(updateThread);
+  finishInit(INIT_STATE_READY);
+  return INIT_OK;
+}
+
+InitCode initReplay(const char *file, double speed) {
+  FILE *f = fopen(file, "rb");
+  char magic[sizeof(RECORD_MAGIC)];
+
+  if (!f)
+    return INIT_ERR_OPEN_FAILED;
+
+  if (fread(magic, 1, sizeof(magic), f) != sizeof(magic) ||
+      memcmp(magic, RECORD_MAGIC, sizeof(magic))) {
+    fclose(f);
+    return INIT_ERR_OPEN_FAILED;
+  }
+
+  info.reset();
+  infoV2 = InfoV2();
+  lastPublished = InfoV2();
+  heartbeat = Heartbeat();
+  markAllChanged();
+  parseState.reset();
+  initStartMono = getMonotonicTime();
+  firstSampleUs = 0;
+  replayFinished = false;
+  replaying = true;
+
+  updateThreadHandle = new std::thread(replayThread, f, speed);
+  finishInit(INIT_STATE_READY);
+  return INIT_OK;
+}
 
-Info info;
-std::mutex mutex;
+bool isReplayFinished() {
+  return replayFinished;
+}
 
-bool httpRequest(const char *request, std::string &buf, const char *POSTData = nullptr);
+bool startRecording(const char *dir) {
+  char path[4096];
+  char timeStr[32];
+  struct tm tm;
 
-int login() {
-  std::string data;
+  if (!localTime(time(nullptr), tm))
+    return false;
 
-  if (!httpRequest("/goform/goform_set_cmd_process", data,
-                   (std::string("isTest=false&goformId=LOGIN&password=") + routerPW).c_str()))
-    return -1;
+  strftime(timeStr, sizeof(timeStr), "%Y%m%d-%H%M%S", &tm);
+  snprintf(path, sizeof(path), "%s/3wg3-watch-%s.rec", dir, timeStr);
 
-  if (data.empty() || data.length() >= 20 || data[0] != '{')
-    return -2;
+  std::lock_guard<std::mutex> lock(recordMutex);
 
-  return data == R"({"result":"0"})" ? 1 : -3;
-}
+  if (recordFile)
+    return false;
 
-bool httpRequest(const char *request, std::string &buf, const char *POSTData) {
-  CURL *curl = curl_easy_init();
+  if (!(recordFile = fopen(path, "ab")))
+    return false;
 
-  if (!curl)
-    abort();
+  if (fseek(recordFile, 0, SEEK_END) == 0 && ftell(recordFile) == 0)
+    fwrite(RECORD_MAGIC, 1, sizeof(RECORD_MAGIC), recordFile);
 
-  std::string req = "http://" + routerIP + request;
-  std::string ref = "http://" + routerIP + "/index.html";
+  return true;
+}
 
-  auto callback = [](void *data, size_t size, size_t nmemb, std::string &buf) {
-    buf.append((const char *)data, size * nmemb);
-    return size * nmemb;
-  };
+void stopRecording() {
+  std::lock_guard<std::mutex> lock(recordMutex);
 
-  buf.clear();
+  if (recordFile) {
+    fclose(recordFile);
+    recordFile = nullptr;
+  }
+}
 
-#define SET_CURL_OPT(OPT, VAL)                                               \
-  if (curl_easy_setopt(curl, OPT, VAL) != CURLE_OK)                          \
-    abort();
+void deinit() {
+  waitForProbes();
 
-  SET_CURL_OPT(CURLOPT_CONNECTTIMEOUT, 30L);
-  SET_CURL_OPT(CURLOPT_TIMEOUT, 30L);
-  SET_CURL_OPT(CURLOPT_URL, req.c_str());
+  if (!updateThreadHandle)
+    return;
 
-  SET_CURL_OPT(CURLOPT_REFERER, ref.c_str());
+  deinitRequest = true;
 
-  if (POSTData)
-    SET_CURL_OPT(CURLOPT_POSTFIELDS, POSTData);
+  updateThreadHandle->join();
+  delete updateThreadHandle;
+  updateThreadHandle = nullptr;
 
-  SET_CURL_OPT(CURLOPT_WRITEFUNCTION, +callback);
-  SET_CURL_OPT(CURLOPT_WRITEDATA, &buf);
-  SET_CURL_OPT(CURLOPT_NOSIGNAL, 1L);
+  if (replaying)
+    replaying = false;
+  else
+    transportCleanup();
 
-  bool res = curl_easy_perform(curl) == CURLE_OK;
+  parsePool.stop();
+  deinitRequest = false;
 
-  curl_easy_cleanup(curl);
+  // Wake everybody still waiting, there will be no more events
+  finishInit(INIT_STATE_IDLE);
 
-  return res;
+  for (int event = 0; event < NOTIFY_EVENT_COUNT; ++event)
+    notify(NotifyEvent(event));
 }
 
-template <typename BUF, size_t N>
-bool getLine(const char *&str, BUF (&buf)[N]) {
-  static_assert(N > 1, "");
+bool notifyOnce(NotifyEvent event, NotifyCallback callback, void *data) {
+  if (event < 0 || event >= NOTIFY_EVENT_COUNT)
+    return false;
 
-  const char *start = str;
-  while (*str && *str++ != '\n');
+  std::lock_guard<std::mutex> lock(notifyMutex);
 
-  if (str == start)
+  if (event == NOTIFY_INIT_DONE && !isInitPending(InitState(initState.load())))
     return false;
 
-  size_t length = std::min<size_t>(N - 1, str - start - 1);
-  memcpy(buf, start, length);
-  buf[length] = '\0';
-
+  notifications[event].push_back({ callback, data });
   return true;
 }
 
-const size_t NPOS = size_t(-1);
-
-size_t find(const char *s, const char *f) {
-  const char *p = strstr(s, f);
-  return p ? p - s : NPOS;
-}
-
-void parseMessages(const std::string &messages, Info &info) {
-  const char *m = messages.c_str();
-  char line[4096];
+bool discoverRouter(char *routerIP, size_t size, int timeoutMs) {
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+  auto discovery = std::make_shared<Discovery>();
+  std::vector<std::string> candidates;
+  char gateway[64];
+
+#ifdef _WIN32
+  // The probes use their own curl handles; curl_easy_init() would otherwise
+  // initialize curl from several threads at once. Released below, once
+  // every probe is done.
+  if (!transportInit())
+    return false;
+#endif
 
-  int prevNetworkType = -1;
+  if (getDefaultGateway(gateway))
+    candidates.push_back(gateway);
 
-  if (info.GotNetworkType)
-    prevNetworkType = info.getNetworkTypeAsInt();
+  for (const char *candidate : DISCOVERY_CANDIDATES) {
+    if (std::find(candidates.begin(), candidates.end(), candidate) == candidates.end())
+      candidates.push_back(candidate);
+  }
 
-  while (getLine(m, line)) {
-    size_t pos;
+  discovery->pending = candidates.size();
 
-    if ((pos = find(line, " ProcAtZrssiRes ")) != NPOS) {
-      const char *s = line + pos + strlen(" ProcAtZrssiRes ");
+  {
+    std::lock_guard<std::mutex> lock(probeMutex);
+    runningProbes += candidates.size();
+  }
 
-      if (sscanf(s, "network_type = %63[^,], ", info.NetworkType) == 1)
-        info.GotNetworkType = true;
-    } else if ((pos = find(line, "AT+ZPAS?^M^M +ZPAS: ")) != NPOS) {
-      const char *s = line + pos + strlen("AT+ZPAS?^M^M +ZPAS: \"");
-      const char *p = strchr(s, '"');
+  // Probes still running after the first answer or the deadline finish on
+  // their own, they only hold a reference to the shared state
+  for (const std::string &candidate : candidates) {
+    std::thread([discovery, candidate, timeoutMs] {
+      char IP[64];
+      bool found = isRouter(candidate.c_str(), timeoutMs, discovery->finished, IP);
 
-      if (p) {
-        size_t len = p - s;
+      {
+        std::lock_guard<std::mutex> lock(discovery->mutex);
 
-        if (len >= sizeof(info.NetworkType))
-          len = sizeof(info.NetworkType) - 1;
+        if (found && !discovery->IP[0])
+          memcpy(discovery->IP, IP, sizeof(IP));
 
-        memcpy(info.NetworkType, s, len);
-        info.NetworkType[len] = '\0';
-        info.GotNetworkType = true;
+        --discovery->pending;
+        discovery->done.notify_all();
       }
-    } else if ((pos = find(line, " +ZRSSI: ")) != NPOS) {
-      const char *s = line + pos + strlen(" +ZRSSI: ");
-      info.RSRP = info.RSCP = info.RSRQ = info.RSSI = 0xffff;
-      info.SINR = info.ECIO = -NAN;
-
-      int N = sscanf(s, "%d,%d,%d,%f", &info.RSRP, &info.RSRQ, &info.RSSI, &info.SINR);
-
-      if (N >= 1) {
-        if (N == 1) { // 2G
-          std::swap(info.RSRP, info.RSSI);
-        } else if (N == 2) { // 3G
-          N = (sscanf(s, "%d,%f", &info.RSCP, &info.ECIO) == 2);
-        } else { // 4G
-#if 0
-          if (info.RSSI < -113)
-            info.CSQ = 0.f;
-          else if (info.RSSI >= -51)
-            info.CSQ = 31.f;
-          else
-            info.CSQ = (113 - (info.RSSI * -1)) / 2.f;
-#endif
-        }
 
-        info.GotSignalStrength = (N > 0);
-      }
-    } else if ((pos = find(line, " +CSQ: ")) != NPOS) {
-      for (char &c : line) if (c == ',') c = '.';
-      const char *s = line + pos + strlen(" +CSQ: ");
+      std::lock_guard<std::mutex> lock(probeMutex);
 
-      if (sscanf(s, "%f", &info.CSQ) == 1)
-        info.GotCSQ = true;
-    } else if ((pos = find(line, "LAC=")) != NPOS) {
-      const char *s = line + pos;
+      if (!--runningProbes)
+        probesDone.notify_all();
+    }).detach();
+  }
 
-      if (sscanf(s, "LAC=%x", &info.LAC) == 1)
-       info.GotLAC = true;
+  char IP[64];
 
-      if ((pos = find(line, "CELL_ID=")) != NPOS) {
-        const char *s = line + pos;
+  {
+    std::unique_lock<std::mutex> lock(discovery->mutex);
+    discovery->done.wait_until(lock, deadline, [&] {
+      return discovery->IP[0] || !discovery->pending;
+    });
 
-        if (sscanf(s, "CELL_ID=%x", &info.GlobalCellID) == 1)
-         info.GotCellID = true;
-      }
-    } else if ((pos = find(line, " +ZDON: ")) != NPOS) {
-      const char *s = line + pos + strlen(" +ZDON: ");
+    memcpy(IP, discovery->IP, sizeof(IP));
+  }
 
-      if (*s++ == '"') {
-        const char *p = strchr(s, '"');
+  discovery->finished = true;
 
-        if (p) {
-          while (*s == ' ')
-            ++s;
+#ifdef _WIN32
+  // curl_global_cleanup() must not run under the remaining probes. Not
+  // transportCleanup(), that would close the main connection of init().
+  waitForProbes();
+  curl_global_cleanup();
+#endif
 
-          size_t len = p - s;
+  if (!IP[0])
+    return false;
 
-          if (len >= sizeof(info.ProviderDesc))
-            len = sizeof(info.ProviderDesc) - 1;
+  snprintf(routerIP, size, "%s", IP);
+  return true;
+}
 
-          memcpy(info.ProviderDesc, s, len);
-          info.ProviderDesc[len] = '\0';
+std::future<InitCode> initAsync(const char *routerIP, const char *routerPW, int updateInterval) {
+  std::string IP(routerIP), PW(routerPW);
 
-          if (*++p == ',') {
-            int MCC, MNC;
+  initState = INIT_STATE_RESOLVING;
 
-            if(sscanf(p, ",%d,%d", &MCC, &MNC) == 2) {
-              char tmp[64];
-              snprintf(tmp, sizeof(tmp), "%d%02d", MCC, MNC);
-              info.MCCMNC = atoi(tmp);
-              info.GotProviderInfo = true;
-            }
-          }
-        }
-      }
-    } else if ((pos = find(line, " +ZCELLINFO: ")) != NPOS) {
-      const char *s = line + pos + strlen(" +ZCELLINFO: ");
-      char band[64];
-
-      // 0: Global Cell ID, 1: Physical Cell ID, 2: Band, 3: Channel
-
-      if (sscanf(s, "%d, %*d, LTE %63[^,], %d", &info.GlobalCellID, band, &info.Channel) == 3) {
-        if (!strcmp(band, "B3"))
-          info.Frequency = 1800;
-        else if (!strcmp(band, "B7"))
-          info.Frequency = 2600;
-        else if (!strcmp(band, "B20"))
-          info.Frequency = 800;
-        else
-          info.Frequency = -1;
+  return std::async(std::launch::async, [=] {
+    return init(IP.c_str(), PW.c_str(), updateInterval);
+  });
+}
 
-        info.GotCellID = true;
-        info.GotFreqency = true;
-        info.GotChannel = true;
-      } else if (sscanf(s, "%*d, %*d, %*s %d", &info.Frequency) >= 1) {
-        info.GotFreqency = true;
-      }
-    }
-  }
+InitState getInitState() {
+  return InitState(initState.load());
+}
 
-  if (prevNetworkType != -1 && info.GotNetworkType &&
-      prevNetworkType != info.getNetworkTypeAsInt()) {
-    info.reset(); // Force clean values after net switch
-    return;
+bool getInfo(Info &info) {
+  mutex.lock();
+  drainEvent();
+  if (!::zte_mf283plus_watch::info.N) {
+    mutex.unlock();
+    return false;
   }
-
-  info.LastUpdate = time(nullptr);
-  info.N++;
+  info = ::zte_mf283plus_watch::info;
+  mutex.unlock();
+  return true;
 }
 
-void updateThread() {
-  std::string data;
+bool getInfoV2(InfoV2 &info) {
+  std::lock_guard<std::mutex> lock(mutex);
+  drainEvent();
 
-  do {
-    if (httpRequest("/goform/goform_set_cmd_process",
-                    data,
-                    "isTest=false&goformId=SYSLOG&syslog_flag=open&syslog_mode=wan_connect") &&
-        httpRequest("/messages",
-                    data)) {
-      if (data.length() > 0 && data[0] == '<') {
-        login();
-      } else {
-        mutex.lock();
-        parseMessages(data, info);
-        mutex.unlock();
-      }
-    }
+  if (!::zte_mf283plus_watch::infoV2.N)
+    return false;
 
-    Sleep(updateInterval);
-  } while (!deinitRequest);
+  info = ::zte_mf283plus_watch::infoV2;
+  return true;
 }
 
-} // unnamed namespace
+bool getHeartbeat(Heartbeat &heartbeat) {
+  std::lock_guard<std::mutex> lock(mutex);
+  heartbeat = ::zte_mf283plus_watch::heartbeat;
+  return heartbeat.Count > 0;
+}
 
-InitCode init(const char *routerIP, const char *routerPW, int updateInterval) {
-#ifndef TEST
-  if (curl_global_init(CURL_GLOBAL_DEFAULT) != CURLE_OK)
-    abort();
+int getEventFD() {
+#ifndef _WIN32
+  std::lock_guard<std::mutex> lock(eventFDMutex);
 
-  char routerPWBase64[1024];
+  if (eventReadFD != -1)
+    return eventReadFD;
 
-  base64_encode(strlen(routerPW), (const unsigned char*)routerPW,
-                sizeof(routerPWBase64), routerPWBase64);
+#ifdef __linux__
+  int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
 
-  ::zte_mf283plus_watch::routerIP = routerIP;
-  ::zte_mf283plus_watch::routerPW = routerPWBase64;
-  ::zte_mf283plus_watch::updateInterval = updateInterval;
+  if (fd == -1)
+    return -1;
 
-  int rc = login();
+  eventWriteFD = fd;
+  eventReadFD = fd;
+#else
+  int fds[2];
 
-  if (rc != 1)
-    curl_global_cleanup();
+  if (pipe(fds))
+    return -1;
 
-  switch (rc) {
-    case -1: return INIT_ERR_HTTP_REQUEST_FAILED;
-    case -2: return INIT_ERR_NOT_A_ZTE_MF283P;
-    case -3: return INIT_ERR_WRONG_PASSWORD;
+  for (int fd : fds) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
   }
 
-  info.reset();
+  eventWriteFD = fds[1];
+  eventReadFD = fds[0];
 #endif
+  return eventReadFD;
+#else
+  return -1;
+#endif
+}
 
-  updateThreadHandle = new std::thread(updateThread);
-  return INIT_OK;
+uint32_t getChanges(uint64_t &version, InfoV2 &info) {
+  std::lock_guard<std::mutex> lock(mutex);
+  uint32_t changes = 0;
+
+  if (!lastPublished.N)
+    return 0;
+
+  // Unknown versions get everything
+  if (version > snapshotVersion)
+    version = 0;
+
+  for (int i = 0; i < CHANGE_COUNT; ++i) {
+    if (changeVersions[i] > version)
+      changes |= 1u << i;
+  }
+
+  info = lastPublished;
+  version = snapshotVersion;
+  return changes;
 }
 
-void deinit() {
-  if (!updateThreadHandle)
-    return;
+size_t encodeDelta(uint32_t changes, const InfoV2 &info, uint8_t *buf, size_t size) {
+  size_t length = 0;
+
+  auto put = [&](uint64_t v) {
+    do {
+      if (length == size)
+        return false;
+      buf[length++] = uint8_t((v & 0x7f) | (v > 0x7f ? 0x80 : 0));
+      v >>= 7;
+    } while (v);
+    return true;
+  };
 
-  deinitRequest = true;
+  if (!put(changes))
+    return 0;
 
-  updateThreadHandle->join();
-  delete updateThreadHandle;
-  updateThreadHandle = nullptr;
-  curl_global_cleanup();
+  for (const DeltaField &field : deltaFields) {
+    if (!(changes & field.change))
+      continue;
+
+    const char *p = (const char *)&info + field.offset;
+
+    switch (field.kind) {
+      case DELTA_UNSIGNED:
+        if (!put(loadUnsigned(p, field.size)))
+          return 0;
+        break;
+      case DELTA_SIGNED: {
+        int64_t v = loadSigned(p, field.size);
+        if (!put((uint64_t(v) << 1) ^ uint64_t(v >> 63)))
+          return 0;
+        break;
+      }
+      case DELTA_FLOAT: {
+        uint64_t v = loadUnsigned(p, 4);
+        if (size - length < 4)
+          return 0;
+        for (int i = 0; i < 4; ++i)
+          buf[length++] = uint8_t(v >> (i * 8));
+        break;
+      }
+    }
+  }
 
-  deinitRequest = false;
+  return length;
 }
 
-bool getInfo(Info &info) {
-  mutex.lock();
-  if (!::zte_mf283plus_watch::info.N) {
-    mutex.unlock();
+size_t applyDelta(const uint8_t *buf, size_t length, InfoV2 &info, uint32_t *changes) {
+  size_t pos = 0;
+
+  auto get = [&](uint64_t &v) {
+    v = 0;
+    for (int shift = 0; pos < length && shift < 64; shift += 7) {
+      uint8_t b = buf[pos++];
+      v |= uint64_t(b & 0x7f) << shift;
+      if (!(b & 0x80))
+        return true;
+    }
     return false;
+  };
+
+  uint64_t mask, v;
+
+  if (!get(mask) || mask >= (1u << CHANGE_COUNT))
+    return 0;
+
+  for (const DeltaField &field : deltaFields) {
+    if (!(mask & field.change))
+      continue;
+
+    char *p = (char *)&info + field.offset;
+
+    if (field.kind == DELTA_FLOAT) {
+      if (length - pos < 4)
+        return 0;
+      v = 0;
+      for (int i = 0; i < 4; ++i)
+        v |= uint64_t(buf[pos++]) << (i * 8);
+    } else if (!get(v)) {
+      return 0;
+    } else if (field.kind == DELTA_SIGNED) {
+      v = (v >> 1) ^ (~(v & 1) + 1);
+    }
+
+    storeValue(p, field.size, v);
   }
-  info = ::zte_mf283plus_watch::info;
-  mutex.unlock();
-  return true;
+
+  if (changes)
+    *changes = uint32_t(mask);
+
+  return pos;
 }
 
 bool fakeGetInfo(Info &info) {
@@ -436,11 +2816,229 @@ bool fakeGetInfo(Info &info) {
   return true;
 }
 
+static_assert(sizeof(InfoV2) <= 128, "InfoV2 should fit in two cache lines");
+
+void convertInfo(const Info &src, InfoV2 &dst) {
+  dst.Size = sizeof(InfoV2);
+  dst.Present = (src.GotNetworkType ? INFO_HAS_NETWORK_TYPE : 0) |
+                (src.GotProviderInfo ? INFO_HAS_PROVIDER_INFO : 0) |
+                (src.GotSignalStrength ? INFO_HAS_SIGNAL_STRENGTH : 0) |
+                (src.GotCSQ ? INFO_HAS_CSQ : 0) |
+                (src.GotLAC ? INFO_HAS_LAC : 0) |
+                (src.GotCellID ? INFO_HAS_CELL_ID : 0) |
+                (src.GotFreqency ? INFO_HAS_FREQUENCY : 0) |
+                (src.GotChannel ? INFO_HAS_CHANNEL : 0);
+  dst.LastUpdate = src.LastUpdate;
+  dst.N = uint32_t(src.N);
+  dst.LAC = src.LAC;
+  dst.GlobalCellID = src.GlobalCellID;
+  dst.Frequency = src.Frequency;
+  dst.Channel = src.Channel;
+  dst.MCCMNC = src.MCCMNC;
+  dst.SINR = src.SINR;
+  dst.ECIO = src.ECIO;
+  dst.CSQ = src.CSQ;
+  dst.RSRP = toInt16(src.RSRP);
+  dst.RSCP = toInt16(src.RSCP);
+  dst.RSRQ = toInt16(src.RSRQ);
+  dst.RSSI = toInt16(src.RSSI);
+  dst.ProviderID = src.ProviderDesc[0] ? internProvider(src.ProviderDesc) : 0;
+  dst.NetworkType = uint8_t(src.getNetworkTypeID());
+
+  ChannelInfo channelInfo;
+  auto rat = RadioAccessTechnology(getNetworkTypeInfo(NetworkTypeID(dst.NetworkType)).RAT);
+
+  if (src.GotChannel && getChannelInfo(rat, src.Channel, channelInfo)) {
+    dst.Band = uint8_t(channelInfo.Band);
+    dst.DLFrequency = channelInfo.DLFrequency;
+    dst.ULFrequency = channelInfo.ULFrequency;
+  } else {
+    dst.Band = 0;
+    dst.DLFrequency = dst.ULFrequency = 0;
+  }
+
+  dst.FetchStartMono = dst.FetchEndMono = dst.PublishMono = 0;
+  dst.FetchStartWall = dst.FetchEndWall = dst.PublishWall = 0;
+  dst.RouterTime = 0;
+}
+
+void convertInfo(const InfoV2 &src, Info &dst) {
+  auto fromInt16 = [](int16_t v) {
+    return v != INFO_V2_NOT_AVAILABLE ? int(v) : 0xffff;
+  };
+
+  dst.reset();
+  dst.LastUpdate = time_t(src.LastUpdate);
+  strncpy(dst.NetworkType, getNetworkTypeInfo(NetworkTypeID(src.NetworkType)).Name,
+          sizeof(dst.NetworkType));
+  strncpy(dst.ProviderDesc, getProviderName(src.ProviderID), sizeof(dst.ProviderDesc));
+  dst.RSRP = fromInt16(src.RSRP);
+  dst.RSCP = fromInt16(src.RSCP);
+  dst.RSRQ = fromInt16(src.RSRQ);
+  dst.RSSI = fromInt16(src.RSSI);
+  dst.SINR = src.SINR;
+  dst.ECIO = src.ECIO;
+  dst.CSQ = src.CSQ;
+  dst.LAC = src.LAC;
+  dst.GlobalCellID = src.GlobalCellID;
+  dst.Frequency = src.Frequency;
+  dst.Channel = src.Channel;
+  dst.MCCMNC = src.MCCMNC;
+  dst.GotNetworkType = !!(src.Present & INFO_HAS_NETWORK_TYPE);
+  dst.GotProviderInfo = !!(src.Present & INFO_HAS_PROVIDER_INFO);
+  dst.GotSignalStrength = !!(src.Present & INFO_HAS_SIGNAL_STRENGTH);
+  dst.GotCSQ = !!(src.Present & INFO_HAS_CSQ);
+  dst.GotLAC = !!(src.Present & INFO_HAS_LAC);
+  dst.GotCellID = !!(src.Present & INFO_HAS_CELL_ID);
+  dst.GotFreqency = !!(src.Present & INFO_HAS_FREQUENCY);
+  dst.GotChannel = !!(src.Present & INFO_HAS_CHANNEL);
+  dst.N = src.N;
+}
+
+const char *getProviderName(uint16_t providerID) {
+  std::lock_guard<std::mutex> lock(providerMutex);
+  return providerID < providerNames.size() ? providerNames[providerID].c_str() : "";
+}
+
+bool setOption(Option option, int value) {
+  switch (option) {
+    case OPT_PARSE_MODE:
+      if (value != PARSE_FORWARD && value != PARSE_REVERSE)
+        return false;
+      parseMode = value;
+      return true;
+    case OPT_BACKFILL:
+      backfill = !!value;
+      return true;
+    case OPT_DATA_SOURCE:
+      if (value != DATA_SOURCE_SYSLOG && value != DATA_SOURCE_STATUS)
+        return false;
+      dataSource = value;
+      return true;
+    case OPT_PARSE_THREADS:
+      if (value < 0 || value > 64)
+        return false;
+      parseThreads = value;
+      return true;
+    case OPT_CONDITIONAL_FETCH:
+      conditionalFetch = !!value;
+      return true;
+    case OPT_FIRST_SNAPSHOT:
+      firstSnapshot = !!value;
+      return true;
+    case OPT_TRANSPORT:
+#ifdef NO_CURL
+      if (value != TRANSPORT_BUILTIN)
+        return false;
+#elif defined(_WIN32)
+      if (value != TRANSPORT_CURL)
+        return false;
+#else
+      if (value != TRANSPORT_CURL && value != TRANSPORT_BUILTIN)
+        return false;
+#endif
+      transport = value;
+      return true;
+  }
+  return false;
+}
+
+void setSampleCallback(SampleCallback callback, void *data) {
+  std::lock_guard<std::mutex> lock(historyMutex);
+  sampleCallback = callback;
+  sampleCallbackData = data;
+}
+
+size_t getSamples(uint64_t *sequence, Sample *samples, size_t count) {
+  std::lock_guard<std::mutex> lock(historyMutex);
+  uint64_t seq = std::max(*sequence, historyEnd > HISTORY_SIZE ? historyEnd - HISTORY_SIZE : 0);
+  size_t n = 0;
+
+  while (seq < historyEnd && n < count)
+    samples[n++] = history[seq++ % HISTORY_SIZE];
+
+  *sequence = seq;
+  return n;
+}
+
+int64_t getMonotonicTime() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool getChannelInfo(RadioAccessTechnology rat, int channel, ChannelInfo &info) {
+  switch (rat) {
+    case RAT_EUTRAN:
+      for (const LTEBand &b : lteBands)
+        if (b.Band && channel >= b.DLOffset && channel <= b.DLLast)
+          return getLTEChannelInfo(b.Band, channel, info);
+      return false;
+    case RAT_UTRAN:
+      return getUTRAChannelInfo(channel, info);
+    case RAT_GERAN:
+      return getGSMChannelInfo(channel, info);
+    default:
+      return false;
+  }
+}
+
+bool getStats(Stats &stats) {
+  bool any = false;
+
+  for (int i = 0; i < PHASE_COUNT; ++i) {
+    histograms[i].get(stats.Phase[i]);
+    any |= stats.Phase[i].Count > 0;
+  }
+
+  stats.SkippedPolls = skippedPolls;
+  stats.FirstSampleUs = firstSampleUs;
+  return any || stats.SkippedPolls || stats.FirstSampleUs;
+}
+
+void resetStats() {
+  for (auto &histogram : histograms)
+    histogram.reset();
+
+  skippedPolls = 0;
+}
+
+const char *getInitStateName(InitState state) {
+  switch (state) {
+    case INIT_STATE_IDLE: return "Idle";
+    case INIT_STATE_RESOLVING: return "Resolving";
+    case INIT_STATE_CONNECTING: return "Connecting";
+    case INIT_STATE_AUTHENTICATING: return "Authenticating";
+    case INIT_STATE_FIRST_SAMPLE: return "Waiting for the first sample";
+    case INIT_STATE_READY: return "Ready";
+    case INIT_STATE_FAILED: return "Failed";
+  }
+  return "??";
+}
+
+const char *getPhaseName(StatsPhase phase) {
+  switch (phase) {
+    case PHASE_NAMELOOKUP: return "DNS";
+    case PHASE_CONNECT: return "Connect";
+    case PHASE_STARTTRANSFER: return "Wait";
+    case PHASE_TRANSFER: return "Transfer";
+    case PHASE_TOTAL: return "HTTP";
+    case PHASE_PARSE: return "Parse";
+    case PHASE_POLL: return "Poll";
+    case PHASE_DATA_AGE: return "Age";
+    case PHASE_COUNT: break;
+  }
+  return "??";
+}
+
 } // namespace zte_mf283plus_watch
 
 
 // C Interface
 
+namespace {
+std::future<zte_mf283plus_watch::InitCode> asyncInit; // see zte_mf283plus_watch_init_async()
+}
+
 extern "C" {
 
 zte_mf283plus_initcode zte_mf283plus_watch_init(const char *router_ip, const char *router_pw, int update_interval) {
@@ -449,6 +3047,53 @@ zte_mf283plus_initcode zte_mf283plus_watch_init(const char *router_ip, const cha
 void zte_mf283plus_watch_deinit() {
   zte_mf283plus_watch::deinit();
 }
+int zte_mf283plus_watch_init_async(const char *router_ip, const char *router_pw, int update_interval) {
+  if (asyncInit.valid())
+    return 0;
+
+  asyncInit = zte_mf283plus_watch::initAsync(router_ip, router_pw, update_interval);
+  return 1;
+}
+zte_mf283plus_initcode zte_mf283plus_watch_wait_init() {
+  if (!asyncInit.valid())
+    return zte_mf283plus_watch::INIT_ERR_HTTP_REQUEST_FAILED;
+
+  return asyncInit.get();
+}
+zte_mf283plus_initstate zte_mf283plus_watch_get_init_state() {
+  return zte_mf283plus_watch::getInitState();
+}
+const char *zte_mf283plus_watch_get_init_state_name(zte_mf283plus_initstate state) {
+  return zte_mf283plus_watch::getInitStateName(state);
+}
+int zte_mf283plus_watch_notify_once(zte_mf283plus_notify_event event,
+                                    zte_mf283plus_notify_callback callback, void *data) {
+  return zte_mf283plus_watch::notifyOnce(event, callback, data);
+}
+int zte_mf283plus_watch_discover_router(char *router_ip, size_t size, int timeout_ms) {
+  return zte_mf283plus_watch::discoverRouter(router_ip, size, timeout_ms);
+}
+int zte_mf283plus_watch_set_option(int option, int value) {
+  return zte_mf283plus_watch::setOption(zte_mf283plus_watch::Option(option), value);
+}
+void zte_mf283plus_watch_set_sample_callback(zte_mf283plus_sample_callback callback, void *data) {
+  zte_mf283plus_watch::setSampleCallback(callback, data);
+}
+size_t zte_mf283plus_watch_get_samples(uint64_t *sequence, zte_mf283plus_sample *samples, size_t count) {
+  return zte_mf283plus_watch::getSamples(sequence, samples, count);
+}
+zte_mf283plus_initcode zte_mf283plus_watch_init_replay(const char *file, double speed) {
+  return zte_mf283plus_watch::initReplay(file, speed);
+}
+int zte_mf283plus_watch_is_replay_finished() {
+  return zte_mf283plus_watch::isReplayFinished();
+}
+int zte_mf283plus_watch_start_recording(const char *dir) {
+  return zte_mf283plus_watch::startRecording(dir);
+}
+void zte_mf283plus_watch_stop_recording() {
+  zte_mf283plus_watch::stopRecording();
+}
 
 zte_mf283plus_info *zte_mf283plus_watch_new_info() {
   return new zte_mf283plus_info;
@@ -460,11 +3105,79 @@ void zte_mf283plus_watch_free_info(zte_mf283plus_info *info) {
 int zte_mf283plus_watch_get_info(zte_mf283plus_info *info) {
   return zte_mf283plus_watch::getInfo(*(zte_mf283plus_watch::Info*)info);
 }
+int zte_mf283plus_watch_get_event_fd() {
+  return zte_mf283plus_watch::getEventFD();
+}
 int zte_mf283plus_watch_fake_get_info(zte_mf283plus_info *info) {
   return zte_mf283plus_watch::fakeGetInfo(*(zte_mf283plus_watch::Info*)info);
 }
+int zte_mf283plus_watch_get_info_v2(zte_mf283plus_info_v2 *info, size_t size) {
+  zte_mf283plus_watch::InfoV2 tmp;
+
+  if (!zte_mf283plus_watch::getInfoV2(tmp))
+    return 0;
+
+  size = std::min(size, sizeof(tmp));
+  tmp.Size = uint32_t(size);
+  memcpy(info, &tmp, size);
+  return 1;
+}
+int zte_mf283plus_watch_get_heartbeat(zte_mf283plus_heartbeat *heartbeat) {
+  return zte_mf283plus_watch::getHeartbeat(*heartbeat);
+}
+uint32_t zte_mf283plus_watch_get_changes(uint64_t *version, zte_mf283plus_info_v2 *info, size_t size) {
+  zte_mf283plus_watch::InfoV2 tmp = zte_mf283plus_watch::InfoV2();
+  uint32_t changes = zte_mf283plus_watch::getChanges(*version, tmp);
+
+  size = std::min(size, sizeof(tmp));
+  tmp.Size = uint32_t(size);
+  memcpy(info, &tmp, size);
+  return changes;
+}
+size_t zte_mf283plus_watch_encode_delta(uint32_t changes, const zte_mf283plus_info_v2 *info,
+                                        uint8_t *buf, size_t size) {
+  return zte_mf283plus_watch::encodeDelta(changes, *info, buf, size);
+}
+size_t zte_mf283plus_watch_apply_delta(const uint8_t *buf, size_t length,
+                                       zte_mf283plus_info_v2 *info, uint32_t *changes) {
+  return zte_mf283plus_watch::applyDelta(buf, length, *info, changes);
+}
+void zte_mf283plus_watch_info_to_v2(const zte_mf283plus_info *src, zte_mf283plus_info_v2 *dst) {
+  zte_mf283plus_watch::convertInfo(*src, *dst);
+}
+void zte_mf283plus_watch_info_from_v2(const zte_mf283plus_info_v2 *src, zte_mf283plus_info *dst) {
+  zte_mf283plus_watch::convertInfo(*src, *dst);
+}
+const char *zte_mf283plus_watch_get_provider_name(uint16_t provider_id) {
+  return zte_mf283plus_watch::getProviderName(provider_id);
+}
+int64_t zte_mf283plus_watch_get_monotonic_time() {
+  return zte_mf283plus_watch::getMonotonicTime();
+}
+int zte_mf283plus_watch_get_channel_info(int rat, int channel, zte_mf283plus_channel_info *info) {
+  return zte_mf283plus_watch::getChannelInfo(zte_mf283plus_watch::RadioAccessTechnology(rat), channel, *info);
+}
 int zte_mf283plus_watch_get_networktype_as_int(zte_mf283plus_info *info) {
   return info->getNetworkTypeAsInt();
 }
+zte_mf283plus_networktype_id zte_mf283plus_watch_get_networktype_id(zte_mf283plus_info *info) {
+  return info->getNetworkTypeID();
+}
+zte_mf283plus_networktype_id zte_mf283plus_watch_classify_networktype(const char *network_type) {
+  return zte_mf283plus_watch::classifyNetworkType(network_type);
+}
+const zte_mf283plus_networktype_info *zte_mf283plus_watch_get_networktype_info(zte_mf283plus_networktype_id id) {
+  return &zte_mf283plus_watch::getNetworkTypeInfo(id);
+}
+
+int zte_mf283plus_watch_get_stats(zte_mf283plus_stats *stats) {
+  return zte_mf283plus_watch::getStats(*stats);
+}
+void zte_mf283plus_watch_reset_stats() {
+  zte_mf283plus_watch::resetStats();
+}
+const char *zte_mf283plus_watch_get_phase_name(zte_mf283plus_stats_phase phase) {
+  return zte_mf283plus_watch::getPhaseName(phase);
+}
 
 } // extern C
@@ -27,9 +27,16 @@
   unknown @ LTEFORUM.AT - December, 2015 / January, 2016
 */
 
+#ifndef ZTE_MF283PLUS_WATCH_H
+#define ZTE_MF283PLUS_WATCH_H
+
 #include <time.h>
 #include <stdint.h>
 
+#ifdef __cplusplus
+#include <future>
+#endif
+
 #if !defined(__cplusplus) && !defined(bool)
 #define bool signed char
 #endif
@@ -38,8 +45,45 @@
 namespace zte_mf283plus_watch {
 #endif
 
+/* Interned Info::NetworkType. Unknown strings are treated as 3G, as
+   getNetworkTypeAsInt() always did. */
+
+enum NetworkTypeID {
+  NETWORK_TYPE_UNKNOWN,
+  NETWORK_TYPE_NO_SERVICE,
+  NETWORK_TYPE_LIMITED_SERVICE,
+  NETWORK_TYPE_GSM,
+  NETWORK_TYPE_GPRS,
+  NETWORK_TYPE_EDGE,
+  NETWORK_TYPE_E_EDGE,
+  NETWORK_TYPE_UMTS,
+  NETWORK_TYPE_WCDMA,
+  NETWORK_TYPE_TD_SCDMA,
+  NETWORK_TYPE_HSDPA,
+  NETWORK_TYPE_HSUPA,
+  NETWORK_TYPE_HSPA,
+  NETWORK_TYPE_HSPA_PLUS,
+  NETWORK_TYPE_DC_HSPA_PLUS,
+  NETWORK_TYPE_LTE,
+  NETWORK_TYPE_COUNT
+};
+
+enum RadioAccessTechnology {
+  RAT_UNKNOWN,
+  RAT_NONE,
+  RAT_GERAN,
+  RAT_UTRAN,
+  RAT_EUTRAN
+};
+
+struct NetworkTypeInfo {
+  const char *Name;
+  uint8_t Generation; /* 0 (no service), 2, 3 or 4 */
+  uint8_t RAT;
+};
+
 struct Info {
-  time_t LastUpdate;
+  time_t LastUpdate; /* Time of the last heartbeat, also when nothing changed */
   char NetworkType[64];
   char ProviderDesc[64];
   int RSRP;
@@ -66,24 +110,299 @@ struct Info {
   size_t N;
 
 #ifdef __cplusplus
+  NetworkTypeID getNetworkTypeID() const;
   int getNetworkTypeAsInt() const;
   void reset();
   Info();
 #endif
 };
 
+/* Compact, versioned snapshot. Optional fields are flagged in the
+   Present mask, strings are stored as interned IDs (see
+   getNetworkTypeInfo() and getProviderName()). New fields are only ever
+   appended, Size tells how much of the structure has been filled. */
+
+enum InfoField {
+  INFO_HAS_NETWORK_TYPE    = 1 << 0,
+  INFO_HAS_PROVIDER_INFO   = 1 << 1,
+  INFO_HAS_SIGNAL_STRENGTH = 1 << 2,
+  INFO_HAS_CSQ             = 1 << 3,
+  INFO_HAS_LAC             = 1 << 4,
+  INFO_HAS_CELL_ID         = 1 << 5,
+  INFO_HAS_FREQUENCY       = 1 << 6,
+  INFO_HAS_CHANNEL         = 1 << 7,
+  INFO_STALE               = 1 << 8  /* Measurements are the last known values of
+                                        this RAT, RouterTime tells their age */
+};
+
+/* Stored in RSRP, RSCP, RSRQ and RSSI when there is no value (0xffff in Info) */
+#define INFO_V2_NOT_AVAILABLE INT16_MIN
+
+struct InfoV2 {
+  uint32_t Size;
+  uint32_t Present;
+  int64_t LastUpdate; /* Time of the last change, see Heartbeat for the last poll */
+  uint32_t N;
+  int32_t LAC;
+  int32_t GlobalCellID;
+  int32_t Frequency;
+  int32_t Channel;
+  int32_t MCCMNC;
+  float SINR;
+  float ECIO;
+  float CSQ;
+  int16_t RSRP;
+  int16_t RSCP;
+  int16_t RSRQ;
+  int16_t RSSI;
+  uint16_t ProviderID;
+  uint8_t NetworkType; /* NetworkTypeID */
+  uint8_t Band;        /* 3GPP band number, 0 if unknown or GSM */
+  int32_t DLFrequency; /* kHz, 0 if unknown */
+  int32_t ULFrequency; /* kHz, 0 if unknown */
+
+  /* Timestamps in ns. *Mono are taken from getMonotonicTime(), *Wall and
+     RouterTime are relative to the epoch. RouterTime is the syslog time of
+     the signal values (second resolution), 0 if unknown. */
+  int64_t FetchStartMono;
+  int64_t FetchEndMono;
+  int64_t PublishMono;
+  int64_t FetchStartWall;
+  int64_t FetchEndWall;
+  int64_t PublishWall;
+  int64_t RouterTime;
+};
+
+/* Fields changed since a version, see getChanges() and encodeDelta() */
+
+enum InfoChange {
+  CHANGE_PRESENT      = 1 << 0,
+  CHANGE_LAST_UPDATE  = 1 << 1,
+  CHANGE_NETWORK_TYPE = 1 << 2,
+  CHANGE_PROVIDER     = 1 << 3,  /* ProviderID, MCCMNC */
+  CHANGE_RSRP         = 1 << 4,
+  CHANGE_RSCP         = 1 << 5,
+  CHANGE_RSRQ         = 1 << 6,
+  CHANGE_RSSI         = 1 << 7,
+  CHANGE_SINR         = 1 << 8,
+  CHANGE_ECIO         = 1 << 9,
+  CHANGE_CSQ          = 1 << 10,
+  CHANGE_LAC          = 1 << 11,
+  CHANGE_CELL_ID      = 1 << 12,
+  CHANGE_FREQUENCY    = 1 << 13,
+  CHANGE_CHANNEL      = 1 << 14,
+  CHANGE_BAND         = 1 << 15, /* Band, DLFrequency, ULFrequency */
+  CHANGE_ROUTER_TIME  = 1 << 16
+};
+
+/* Upper bound of encodeDelta() */
+#define INFO_V2_DELTA_MAX_SIZE 128
+
+/* Snapshots are only published, and N only incremented, when a value
+   changed. Every successful poll is a heartbeat, also when it confirmed the
+   current snapshot, so consumers can tell stale data from stable data. */
+
+struct Heartbeat {
+  uint64_t Count;
+  int64_t LastMono; /* getMonotonicTime() of the last heartbeat */
+  int64_t LastWall;
+};
+
+/* Result of the band / channel number (EARFCN, UARFCN, ARFCN) lookup */
+
+struct ChannelInfo {
+  uint16_t Band;        /* 3GPP band number, 0 for GSM */
+  uint16_t NominalMHz;  /* e.g. 1800 for LTE band 3 */
+  int32_t DLFrequency;  /* kHz */
+  int32_t ULFrequency;  /* kHz, 0 for downlink only channels */
+  int32_t Bandwidth;    /* kHz, width of the downlink band */
+};
+
 enum InitCode {
   INIT_OK,
   INIT_ERR_HTTP_REQUEST_FAILED,
   INIT_ERR_NOT_A_ZTE_MF283P,
-  INIT_ERR_WRONG_PASSWORD
+  INIT_ERR_WRONG_PASSWORD,
+  INIT_ERR_OPEN_FAILED
+};
+
+/* One-shot notifications, see notifyOnce() */
+
+enum NotifyEvent {
+  NOTIFY_SAMPLE,         /* A new snapshot was published */
+  NOTIFY_NETWORK_CHANGE, /* The published NetworkType changed */
+  NOTIFY_INIT_DONE,      /* init() / initAsync() finished, see getInitState() */
+  NOTIFY_EVENT_COUNT
+};
+
+typedef void (*NotifyCallback)(void *data);
+
+/* Progress of init(), see getInitState() */
+
+enum InitState {
+  INIT_STATE_IDLE,
+  INIT_STATE_RESOLVING,
+  INIT_STATE_CONNECTING,
+  INIT_STATE_AUTHENTICATING,
+  INIT_STATE_FIRST_SAMPLE, /* Only with OPT_FIRST_SNAPSHOT */
+  INIT_STATE_READY,
+  INIT_STATE_FAILED
+};
+
+/* Settings, see setOption() */
+
+enum Option {
+  OPT_PARSE_MODE,        /* ParseMode, default: PARSE_REVERSE */
+  OPT_BACKFILL,          /* Extract every measurement of the syslog, see getSamples(), default: 0 */
+  OPT_DATA_SOURCE,       /* DataSource, default: DATA_SOURCE_SYSLOG, takes effect on the next init() */
+  OPT_TRANSPORT,         /* Transport, default: TRANSPORT_CURL, TRANSPORT_BUILTIN if built with NO_CURL */
+  OPT_CONDITIONAL_FETCH, /* Probe the syslog for changes before fetching it, default: 0 */
+  OPT_PARSE_THREADS,     /* Threads for PARSE_FORWARD of large syslogs (0..64), default: 0 (serial) */
+  OPT_FIRST_SNAPSHOT     /* Fetch the first sample in init(), in parallel with the login, default: 0 */
+};
+
+enum DataSource {
+  DATA_SOURCE_SYSLOG, /* Scrape the syslog (/messages) */
+  DATA_SOURCE_STATUS  /* Query the JSON status API (goform_get_cmd_process) */
+};
+
+enum Transport {
+  TRANSPORT_CURL,   /* libcurl, not available if built with NO_CURL */
+  TRANSPORT_BUILTIN /* Built-in keep-alive HTTP/1.1 client, not available on Windows */
+};
+
+enum ParseMode {
+  PARSE_FORWARD, /* Walk the whole syslog */
+  PARSE_REVERSE  /* Walk the syslog backwards until every record has been seen */
+};
+
+/* A single +ZRSSI or +CSQ line of the syslog. Each poll delivers all lines
+   logged since the previous poll, ordered by time. */
+
+enum SampleKind {
+  SAMPLE_SIGNAL, /* RSRP, RSCP, RSRQ, RSSI, SINR and ECIO are valid */
+  SAMPLE_CSQ     /* CSQ is valid */
+};
+
+struct Sample {
+  int64_t RouterTime;  /* syslog time of the line, ns since the epoch */
+  uint8_t Kind;        /* SampleKind */
+  uint8_t NetworkType; /* NetworkTypeID */
+  int16_t RSRP;
+  int16_t RSCP;
+  int16_t RSRQ;
+  int16_t RSSI;
+  float SINR;
+  float ECIO;
+  float CSQ;
+};
+
+typedef void (*SampleCallback)(const struct Sample *samples, size_t count, void *data);
+
+/* Latency of the individual poll phases. The HTTP phases are taken from
+   the transport's timing info and are not cumulative, i.e. PHASE_STARTTRANSFER is
+   the time from connect until the first byte arrived (router processing)
+   and PHASE_TRANSFER is the time from the first to the last byte. */
+
+enum StatsPhase {
+  PHASE_NAMELOOKUP,
+  PHASE_CONNECT,
+  PHASE_STARTTRANSFER,
+  PHASE_TRANSFER,
+  PHASE_TOTAL,
+  PHASE_PARSE,
+  PHASE_POLL,     /* Fetch start until publish */
+  PHASE_DATA_AGE, /* Syslog time of the signal values until publish */
+  PHASE_COUNT
+};
+
+struct PhaseStats {
+  uint64_t Count;
+  uint64_t MinUs;
+  uint64_t MaxUs;
+  uint64_t AvgUs;
+  uint64_t P50Us;
+  uint64_t P90Us;
+  uint64_t P99Us;
+};
+
+struct Stats {
+  struct PhaseStats Phase[PHASE_COUNT];
+  uint64_t SkippedPolls; /* Syslog polls skipped as unchanged, see OPT_CONDITIONAL_FETCH */
+  uint64_t FirstSampleUs; /* Time from init() to the first published sample, 0 if none yet */
 };
 
 #ifdef __cplusplus
+/* init() fails within about a second if the router does not accept
+   connections. initAsync() runs it on another thread, getInitState()
+   reports its progress. Call deinit() only after the future is ready. */
 InitCode init(const char *routerIP, const char *routerPW, int updateInterval = 1000);
+std::future<InitCode> initAsync(const char *routerIP, const char *routerPW, int updateInterval = 1000);
+InitState getInitState();
+const char *getInitStateName(InitState state);
 void deinit();
+
+/* Calls callback once, on the thread raising the event: the update thread
+   for samples, the thread running init() for NOTIFY_INIT_DONE. deinit()
+   calls all pending callbacks, do not call deinit() from a callback.
+   Returns false without registering if init() is not pending for
+   NOTIFY_INIT_DONE. Used by zte_mf283plus_watch_coro.h. */
+bool notifyOnce(NotifyEvent event, NotifyCallback callback, void *data);
+
+/* Probes the default gateway, common 192.168.x.1 addresses and
+   ralink.ralinktech.com at the same time and copies the IP of the first
+   one answering like the router to routerIP */
+bool discoverRouter(char *routerIP, size_t size, int timeoutMs = 1000);
+bool setOption(Option option, int value);
+
+/* The callback is invoked from the update thread with every new batch.
+   getSamples() copies up to count samples newer than *sequence out of a
+   ring of the last 4096 samples and advances *sequence (start with 0). */
+void setSampleCallback(SampleCallback callback, void *data);
+size_t getSamples(uint64_t *sequence, Sample *samples, size_t count);
+
+/* Replays a file written by startRecording() instead of polling the router.
+   speed is a multiplier of the recorded pace, <= 0 replays at max speed.
+   Use deinit() to stop. */
+InitCode initReplay(const char *file, double speed = 1.0);
+bool isReplayFinished();
+
+/* Appends every raw HTTP response to a new file in dir */
+bool startRecording(const char *dir);
+void stopRecording();
 bool getInfo(Info &info);
+bool getInfoV2(InfoV2 &info);
+bool getHeartbeat(Heartbeat &heartbeat);
+
+/* version is the version the caller has seen, 0 for everything, and is set
+   to the version of info. Returns the InfoChange bits changed since then,
+   info is the whole snapshot. Timestamps are not tracked. */
+uint32_t getChanges(uint64_t &version, InfoV2 &info);
+
+/* Compact encoding of the changed fields (LEB128 / zigzag varints, floats
+   as 4 bytes). encodeDelta() returns the length, 0 if size is too small.
+   applyDelta() updates the changed fields of info and returns the bytes
+   consumed, 0 if buf is malformed. ProviderID is only valid in this
+   process, use MCCMNC on the other end. */
+size_t encodeDelta(uint32_t changes, const InfoV2 &info, uint8_t *buf, size_t size);
+size_t applyDelta(const uint8_t *buf, size_t length, InfoV2 &info, uint32_t *changes);
+
+/* File descriptor which becomes readable when a new snapshot is published,
+   for poll() / epoll based event loops. getInfo() and getInfoV2() drain it.
+   Created on the first call and kept open for the lifetime of the process,
+   -1 on Windows or on failure. */
+int getEventFD();
 bool fakeGetInfo(Info &info);
+void convertInfo(const Info &src, InfoV2 &dst);
+void convertInfo(const InfoV2 &src, Info &dst);
+const char *getProviderName(uint16_t providerID);
+int64_t getMonotonicTime();
+bool getChannelInfo(RadioAccessTechnology rat, int channel, ChannelInfo &info);
+NetworkTypeID classifyNetworkType(const char *networkType);
+const NetworkTypeInfo &getNetworkTypeInfo(NetworkTypeID id);
+bool getStats(Stats &stats);
+void resetStats();
+const char *getPhaseName(StatsPhase phase);
 } // namespace zte_mf283plus_watch
 #endif
 
@@ -92,22 +411,88 @@ bool fakeGetInfo(Info &info);
 #ifdef __cplusplus
 extern "C" {
 typedef zte_mf283plus_watch::Info zte_mf283plus_info;
+typedef zte_mf283plus_watch::InfoV2 zte_mf283plus_info_v2;
+typedef zte_mf283plus_watch::Heartbeat zte_mf283plus_heartbeat;
 typedef zte_mf283plus_watch::InitCode zte_mf283plus_initcode;
+typedef zte_mf283plus_watch::InitState zte_mf283plus_initstate;
+typedef zte_mf283plus_watch::NotifyEvent zte_mf283plus_notify_event;
+typedef zte_mf283plus_watch::NotifyCallback zte_mf283plus_notify_callback;
+typedef zte_mf283plus_watch::ChannelInfo zte_mf283plus_channel_info;
+typedef zte_mf283plus_watch::Sample zte_mf283plus_sample;
+typedef zte_mf283plus_watch::SampleCallback zte_mf283plus_sample_callback;
+typedef zte_mf283plus_watch::Stats zte_mf283plus_stats;
+typedef zte_mf283plus_watch::StatsPhase zte_mf283plus_stats_phase;
+typedef zte_mf283plus_watch::NetworkTypeID zte_mf283plus_networktype_id;
+typedef zte_mf283plus_watch::NetworkTypeInfo zte_mf283plus_networktype_info;
 #else
 typedef struct Info zte_mf283plus_info;
+typedef struct InfoV2 zte_mf283plus_info_v2;
+typedef struct Heartbeat zte_mf283plus_heartbeat;
 typedef enum InitCode zte_mf283plus_initcode;
+typedef enum InitState zte_mf283plus_initstate;
+typedef enum NotifyEvent zte_mf283plus_notify_event;
+typedef NotifyCallback zte_mf283plus_notify_callback;
+typedef struct ChannelInfo zte_mf283plus_channel_info;
+typedef struct Sample zte_mf283plus_sample;
+typedef SampleCallback zte_mf283plus_sample_callback;
+typedef struct Stats zte_mf283plus_stats;
+typedef enum StatsPhase zte_mf283plus_stats_phase;
+typedef enum NetworkTypeID zte_mf283plus_networktype_id;
+typedef struct NetworkTypeInfo zte_mf283plus_networktype_info;
 #endif
 
 zte_mf283plus_initcode zte_mf283plus_watch_init(const char *router_ip, const char *router_pw, int update_interval);
 void zte_mf283plus_watch_deinit();
 
+/* Starts init() on another thread, returns 0 while the result of the previous
+   call has not been collected with zte_mf283plus_watch_wait_init() */
+int zte_mf283plus_watch_init_async(const char *router_ip, const char *router_pw, int update_interval);
+zte_mf283plus_initcode zte_mf283plus_watch_wait_init();
+zte_mf283plus_initstate zte_mf283plus_watch_get_init_state();
+const char *zte_mf283plus_watch_get_init_state_name(zte_mf283plus_initstate state);
+int zte_mf283plus_watch_notify_once(zte_mf283plus_notify_event event,
+                                    zte_mf283plus_notify_callback callback, void *data);
+int zte_mf283plus_watch_discover_router(char *router_ip, size_t size, int timeout_ms);
+int zte_mf283plus_watch_set_option(int option, int value);
+void zte_mf283plus_watch_set_sample_callback(zte_mf283plus_sample_callback callback, void *data);
+size_t zte_mf283plus_watch_get_samples(uint64_t *sequence, zte_mf283plus_sample *samples, size_t count);
+
+zte_mf283plus_initcode zte_mf283plus_watch_init_replay(const char *file, double speed);
+int zte_mf283plus_watch_is_replay_finished();
+int zte_mf283plus_watch_start_recording(const char *dir);
+void zte_mf283plus_watch_stop_recording();
+
 zte_mf283plus_info *zte_mf283plus_watch_new_info();
 void zte_mf283plus_watch_free_info(zte_mf283plus_info *info);
 
 int zte_mf283plus_watch_get_info(zte_mf283plus_info *info);
+int zte_mf283plus_watch_get_event_fd();
 int zte_mf283plus_watch_fake_get_info(zte_mf283plus_info *info);
+
+/* Fills at most size bytes of info, pass sizeof(zte_mf283plus_info_v2) */
+int zte_mf283plus_watch_get_info_v2(zte_mf283plus_info_v2 *info, size_t size);
+int zte_mf283plus_watch_get_heartbeat(zte_mf283plus_heartbeat *heartbeat);
+uint32_t zte_mf283plus_watch_get_changes(uint64_t *version, zte_mf283plus_info_v2 *info, size_t size);
+size_t zte_mf283plus_watch_encode_delta(uint32_t changes, const zte_mf283plus_info_v2 *info,
+                                        uint8_t *buf, size_t size);
+size_t zte_mf283plus_watch_apply_delta(const uint8_t *buf, size_t length,
+                                       zte_mf283plus_info_v2 *info, uint32_t *changes);
+void zte_mf283plus_watch_info_to_v2(const zte_mf283plus_info *src, zte_mf283plus_info_v2 *dst);
+void zte_mf283plus_watch_info_from_v2(const zte_mf283plus_info_v2 *src, zte_mf283plus_info *dst);
+const char *zte_mf283plus_watch_get_provider_name(uint16_t provider_id);
+int64_t zte_mf283plus_watch_get_monotonic_time();
+int zte_mf283plus_watch_get_channel_info(int rat, int channel, zte_mf283plus_channel_info *info);
 int zte_mf283plus_watch_get_networktype_as_int(zte_mf283plus_info *info);
+zte_mf283plus_networktype_id zte_mf283plus_watch_get_networktype_id(zte_mf283plus_info *info);
+zte_mf283plus_networktype_id zte_mf283plus_watch_classify_networktype(const char *network_type);
+const zte_mf283plus_networktype_info *zte_mf283plus_watch_get_networktype_info(zte_mf283plus_networktype_id id);
+
+int zte_mf283plus_watch_get_stats(zte_mf283plus_stats *stats);
+void zte_mf283plus_watch_reset_stats();
+const char *zte_mf283plus_watch_get_phase_name(zte_mf283plus_stats_phase phase);
 
 #ifdef __cplusplus
 } // extern C
 #endif
+
+#endif /* ZTE_MF283PLUS_WATCH_H */
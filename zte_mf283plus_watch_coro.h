@@ -0,0 +1,110 @@
+/*
+  This is free and unencumbered software released into the public domain.
+
+  Anyone is free to copy, modify, publish, use, compile, sell, or
+  distribute this software, either in source code form or as a compiled
+  binary, for any purpose, commercial or non-commercial, and by any
+  means.
+
+  In jurisdictions that recognize copyright laws, the author or authors
+  of this software dedicate any and all copyright interest in the
+  software to the public domain. We make this dedication for the benefit
+  of the public at large and to the detriment of our heirs and
+  successors. We intend this dedication to be an overt act of
+  relinquishment in perpetuity of all present and future rights to this
+  software under copyright law.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+  OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+  OTHER DEALINGS IN THE SOFTWARE.
+
+  For more information, please refer to <http://unlicense.org/>
+*/
+
+// Optional C++20 coroutine layer, the library itself stays C++11.
+//
+//   zte_mf283plus_watch::coro::Task monitor() {
+//     while (auto info = co_await zte_mf283plus_watch::coro::nextSample())
+//       ...
+//   }
+//
+// Awaiting coroutines are resumed by the library's own threads through
+// notifyOnce(), there is no thread per consumer. They continue on that
+// thread until their next co_await, so keep the work in between short and
+// never call deinit() from it.
+
+#ifndef ZTE_MF283PLUS_WATCH_CORO_H
+#define ZTE_MF283PLUS_WATCH_CORO_H
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+
+#include "zte_mf283plus_watch.h"
+
+namespace zte_mf283plus_watch {
+namespace coro {
+
+class NotifyAwaiter {
+public:
+  explicit NotifyAwaiter(NotifyEvent event) : event(event) {}
+
+  bool await_ready() const noexcept { return false; }
+
+  bool await_suspend(std::coroutine_handle<> handle) noexcept {
+    auto resume = [](void *data) { std::coroutine_handle<>::from_address(data).resume(); };
+    return notifyOnce(event, resume, handle.address());
+  }
+
+private:
+  NotifyEvent event;
+};
+
+// Yields the published snapshot, std::nullopt once deinit() was called
+class SnapshotAwaiter : public NotifyAwaiter {
+public:
+  using NotifyAwaiter::NotifyAwaiter;
+
+  std::optional<InfoV2> await_resume() const {
+    InfoV2 info;
+
+    if (getInitState() == INIT_STATE_IDLE || !getInfoV2(info))
+      return std::nullopt;
+
+    return info;
+  }
+};
+
+// Yields INIT_STATE_READY or INIT_STATE_FAILED, or the current state if
+// no init() is pending
+class InitAwaiter : public NotifyAwaiter {
+public:
+  InitAwaiter() : NotifyAwaiter(NOTIFY_INIT_DONE) {}
+
+  InitState await_resume() const { return getInitState(); }
+};
+
+inline SnapshotAwaiter nextSample() { return SnapshotAwaiter(NOTIFY_SAMPLE); }
+inline SnapshotAwaiter nextNetworkChange() { return SnapshotAwaiter(NOTIFY_NETWORK_CHANGE); }
+inline InitAwaiter loginDone() { return InitAwaiter(); }
+
+// Fire and forget coroutine, runs until its first co_await on the calling
+// thread
+struct Task {
+  struct promise_type {
+    Task get_return_object() noexcept { return {}; }
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() noexcept {}
+    void unhandled_exception() noexcept { std::terminate(); }
+  };
+};
+
+} // namespace coro
+} // namespace zte_mf283plus_watch
+
+#endif // ZTE_MF283PLUS_WATCH_CORO_H